@@ -0,0 +1,152 @@
+/*  fixed_cache.h
+ *  ─────────────────────────────────────────────────────────────────────
+ *  LRU-кэш, специализированный под ключ и значение фиксированного размера.
+ *
+ *  FIXED_CACHE_DEFINE(name, key_type, value_type) порождает тип name и
+ *  функции name_create, name_put, name_get, name_destroy – те же операции,
+ *  что add_to_cache / get_from_cache у Cache, но:
+ *
+ *  * ключи и значения лежат прямо в массивах кэша, всё выделяется одним
+ *    блоком в name_create (массивы выровнены под свои типы), put и get
+ *    не обращаются к аллокатору;
+ *  * ключи сравниваются memcmp фиксированного размера, который для 8 и
+ *    16 байт компилятор превращает в одно-два целочисленных сравнения;
+ *    ключи хранятся отдельным плотным массивом, поиск идёт по нему
+ *    подряд;
+ *  * список LRU – индексы int32_t вместо указателей.
+ *
+ *  Семантика как у Cache: новый ключ встаёт в голову, при переполнении
+ *  вытесняется хвост (его ячейка сразу переиспользуется), обновление
+ *  существующего ключа не меняет его место, get переносит найденный
+ *  ключ в голову.  Все операции под мьютексом кэша.
+ *
+ *  Байты заполнения в key_type участвуют в сравнении, поэтому ключи-
+ *  структуры нужно обнулять перед заполнением.
+ *
+ *  Пример:
+ *      typedef struct { char bytes[16]; } Value16;
+ *      FIXED_CACHE_DEFINE(u64_cache, uint64_t, Value16)
+ *
+ *      u64_cache *c = u64_cache_create(64);
+ *      u64_cache_put(c, &key, &value);
+ *      if (u64_cache_get(c, &key, &out) == 0) ...
+ *  ----------------------------------------------------------------------- */
+
+#ifndef FIXED_CACHE_H
+#define FIXED_CACHE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* a – степень двойки */
+#define FIXED_CACHE_ALIGN_UP(x, a) (((x) + (a) - 1) & ~((size_t)(a) - 1))
+
+#define FIXED_CACHE_DEFINE(name, key_type, value_type)                         \
+                                                                               \
+typedef struct {                                                               \
+    pthread_mutex_t lock;                                                      \
+    int count;                                                                 \
+    int max_size;                                                              \
+    int32_t head, tail;               /* -1 – пусто */                         \
+    key_type *keys;                   /* занято [0, count) */                  \
+    value_type *values;                                                        \
+    int32_t *next, *prev;                                                      \
+} name;                                                                        \
+                                                                               \
+static inline name *name##_create(int max_size) {                              \
+    if (max_size < 1) return NULL;                                             \
+    size_t n = (size_t)max_size;                                               \
+    /* за структурой: next, prev, keys, values; смещение каждого массива       \
+     * округлено до выравнивания его типа */                                   \
+    size_t off_next = FIXED_CACHE_ALIGN_UP(sizeof(name), _Alignof(int32_t));   \
+    size_t off_prev = off_next + n * sizeof(int32_t);                          \
+    size_t off_keys = FIXED_CACHE_ALIGN_UP(off_prev + n * sizeof(int32_t),     \
+                                           _Alignof(key_type));                \
+    size_t off_values = FIXED_CACHE_ALIGN_UP(off_keys + n * sizeof(key_type),  \
+                                             _Alignof(value_type));            \
+    size_t align = _Alignof(name);                                             \
+    if (_Alignof(key_type) > align) align = _Alignof(key_type);                \
+    if (_Alignof(value_type) > align) align = _Alignof(value_type);            \
+    /* aligned_alloc – на случай выравнивания больше, чем даёт malloc */       \
+    name *cache = aligned_alloc(align, FIXED_CACHE_ALIGN_UP(                   \
+                      off_values + n * sizeof(value_type), align));            \
+    if (!cache) return NULL;                                                   \
+    cache->next = (int32_t *)((char *)cache + off_next);                       \
+    cache->prev = (int32_t *)((char *)cache + off_prev);                       \
+    cache->keys = (key_type *)((char *)cache + off_keys);                      \
+    cache->values = (value_type *)((char *)cache + off_values);                \
+    cache->count = 0;                                                          \
+    cache->max_size = max_size;                                                \
+    cache->head = cache->tail = -1;                                            \
+    pthread_mutex_init(&cache->lock, NULL);                                    \
+    return cache;                                                              \
+}                                                                              \
+                                                                               \
+static inline void name##_destroy(name *cache) {                               \
+    if (!cache) return;                                                        \
+    pthread_mutex_destroy(&cache->lock);                                       \
+    free(cache);                                                               \
+}                                                                              \
+                                                                               \
+static inline int32_t name##_find_locked(const name *cache,                    \
+                                         const key_type *key) {                \
+    for (int32_t i = 0; i < cache->count; i++)                                 \
+        if (memcmp(&cache->keys[i], key, sizeof(key_type)) == 0) return i;     \
+    return -1;                                                                 \
+}                                                                              \
+                                                                               \
+static inline void name##_unlink_locked(name *cache, int32_t i) {              \
+    if (cache->prev[i] >= 0) cache->next[cache->prev[i]] = cache->next[i];     \
+    else cache->head = cache->next[i];                                         \
+    if (cache->next[i] >= 0) cache->prev[cache->next[i]] = cache->prev[i];     \
+    else cache->tail = cache->prev[i];                                         \
+}                                                                              \
+                                                                               \
+static inline void name##_push_head_locked(name *cache, int32_t i) {           \
+    cache->prev[i] = -1;                                                       \
+    cache->next[i] = cache->head;                                              \
+    if (cache->head >= 0) cache->prev[cache->head] = i;                        \
+    cache->head = i;                                                           \
+    if (cache->tail < 0) cache->tail = i;                                      \
+}                                                                              \
+                                                                               \
+static inline void name##_put(name *cache, const key_type *key,                \
+                              const value_type *value) {                       \
+    if (!cache || !key || !value) return;                                      \
+    pthread_mutex_lock(&cache->lock);                                          \
+    int32_t i = name##_find_locked(cache, key);                                \
+    if (i < 0) {                                                               \
+        if (cache->count < cache->max_size) {                                  \
+            i = cache->count++;                                                \
+        } else {                                                               \
+            /* вытеснение хвоста: его ячейка достаётся новому ключу */         \
+            i = cache->tail;                                                   \
+            name##_unlink_locked(cache, i);                                    \
+        }                                                                      \
+        cache->keys[i] = *key;                                                 \
+        name##_push_head_locked(cache, i);                                     \
+    }                                                                          \
+    cache->values[i] = *value;                                                 \
+    pthread_mutex_unlock(&cache->lock);                                        \
+}                                                                              \
+                                                                               \
+/* 0 и копия значения в out (если out != NULL) или -1, если ключа нет */       \
+static inline int name##_get(name *cache, const key_type *key,                 \
+                             value_type *out) {                                \
+    if (!cache || !key) return -1;                                             \
+    pthread_mutex_lock(&cache->lock);                                          \
+    int32_t i = name##_find_locked(cache, key);                                \
+    if (i >= 0) {                                                              \
+        if (i != cache->head) {                                                \
+            name##_unlink_locked(cache, i);                                    \
+            name##_push_head_locked(cache, i);                                 \
+        }                                                                      \
+        if (out) *out = cache->values[i];                                      \
+    }                                                                          \
+    pthread_mutex_unlock(&cache->lock);                                        \
+    return i >= 0 ? 0 : -1;                                                    \
+}
+
+#endif /* FIXED_CACHE_H */
@@ -0,0 +1,457 @@
+/*  heap_sampler.c
+ *  ─────────────────────────────────────────────────────────────────────
+ *  Семплирующий профилировщик кучи, подгружаемый через LD_PRELOAD.
+ *
+ *  * В отличие от leak_tracker.c, стек снимается не для каждого
+ *    выделения, а в среднем раз в HEAP_SAMPLER_RATE_KB килобайт:
+ *    расстояние между выборками – экспоненциальное (пуассоновский
+ *    процесс по байтам), как в tcmalloc/jemalloc.  Остальные вызовы
+ *    стоят одного вычитания из счётчика в TLS.
+ *  * По каждому стеку накапливаются выбранные объекты и байты – всего
+ *    выделено (alloc) и ещё живо (inuse).
+ *  * Дамп пишется при завершении и по сигналу (по умолчанию SIGUSR2):
+ *      <prefix>.<pid>.<n>.heap           – формат heap_v2 для pprof
+ *      <prefix>.<pid>.<n>.inuse.folded   – живые байты, folded stacks
+ *      <prefix>.<pid>.<n>.alloc.folded   – всего выделено, folded stacks
+ *    В folded-файлах значения уже пересчитаны из выборки в оценку
+ *    полного объёма; pprof делает такой пересчёт сам.
+ *
+ *  Компиляция:
+ *      gcc -O2 -g -shared -fPIC -fno-omit-frame-pointer \
+ *          -o libheap_sampler.so heap_sampler.c -ldl -lm -pthread
+ *
+ *  Запуск (-rdynamic нужен для имён функций в folded-файлах):
+ *      HEAP_SAMPLER_RATE_KB=1 LD_PRELOAD=./libheap_sampler.so \
+ *          ./prog_2_files_cache 1
+ *      pprof -text ./prog_2_files_cache heap_sampler.<pid>.0.heap
+ *      flamegraph.pl heap_sampler.<pid>.0.inuse.folded > heap.svg
+ *
+ *  Переменные окружения:
+ *      HEAP_SAMPLER_RATE_KB=<n>   – средний шаг выборки, КиБ (512)
+ *      HEAP_SAMPLER_OUT=<prefix>  – префикс файлов дампа (heap_sampler)
+ *      HEAP_SAMPLER_SIGNAL=<n>    – номер сигнала для дампа, 0 – выкл.
+ *  ----------------------------------------------------------------------- */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "preload_hooks.h"
+
+#define MAX_FRAMES        32
+#define SAMPLE_TABLE_BITS 18         /* одновременно живых выборок */
+#define SITE_TABLE_BITS   14         /* различных стеков с выборками */
+#define DEFAULT_RATE_KB   512
+
+#define SAMPLE_EMPTY ((uintptr_t)0)
+#define SAMPLE_TOMB  ((uintptr_t)1)
+
+/* ---------------------------------------------------------------------- */
+/*  Таблицы                                                                */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    _Atomic uintptr_t addr;          /* SAMPLE_EMPTY / SAMPLE_TOMB / адрес */
+    size_t size;
+    uint32_t site;
+} SampleSlot;
+
+typedef struct {
+    _Atomic uint64_t hash;           /* 0 – слот свободен */
+    _Atomic int ready;               /* кадры записаны */
+    int depth;
+    void *frames[MAX_FRAMES];
+    /* сырые значения выборки, без пересчёта */
+    _Atomic size_t alloc_objs;
+    _Atomic size_t alloc_bytes;
+    _Atomic size_t inuse_objs;
+    _Atomic size_t inuse_bytes;
+} SiteSlot;
+
+static SampleSlot *samples;
+static SiteSlot *sites;
+static _Atomic int init_state;       /* 0 – нет, 1 – идёт, 2 – готово */
+static double sample_rate;           /* средний шаг выборки, байты */
+static _Atomic int dump_requested;
+static _Atomic unsigned dump_seq;
+static pthread_mutex_t dump_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static HOOK_TLS int in_hook;
+static HOOK_TLS ssize_t bytes_until_sample;
+static HOOK_TLS int sample_armed;    /* у потока уже есть первый шаг */
+static HOOK_TLS uint64_t rng_state;
+
+static int ensure_init(void) {
+    int state = atomic_load_explicit(&init_state, memory_order_acquire);
+    if (state == 2) return 1;
+
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&init_state, &expected, 1)) {
+        samples = map_zeroed(sizeof(SampleSlot) << SAMPLE_TABLE_BITS);
+        sites = map_zeroed(sizeof(SiteSlot) << SITE_TABLE_BITS);
+        sample_rate = DEFAULT_RATE_KB * 1024.0;
+        atomic_store_explicit(&init_state, 2, memory_order_release);
+    }
+    while (atomic_load_explicit(&init_state, memory_order_acquire) != 2)
+        ;
+    return samples && sites;
+}
+
+/* Следующий шаг: экспоненциальное распределение со средним sample_rate */
+static ssize_t next_sample_interval(void) {
+    if (!rng_state) rng_state = mix64((uintptr_t)&rng_state ^ (uint64_t)time(NULL)) | 1;
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    double u = ((rng_state >> 11) + 1.0) / 9007199254740993.0;    /* (0, 1] */
+    return (ssize_t)(-log(u) * sample_rate) + 1;
+}
+
+static uint32_t intern_site(void **frames, int depth) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    for (int i = 0; i < depth; i++)
+        h = mix64(h ^ (uintptr_t)frames[i]);
+    if (h == 0) h = 1;
+
+    size_t mask = ((size_t)1 << SITE_TABLE_BITS) - 1;
+    for (size_t i = 0, idx = h & mask; i <= mask; i++, idx = (idx + 1) & mask) {
+        uint64_t cur = atomic_load_explicit(&sites[idx].hash, memory_order_acquire);
+        if (cur == 0) {
+            uint64_t expected = 0;
+            if (atomic_compare_exchange_strong(&sites[idx].hash, &expected, h)) {
+                memcpy(sites[idx].frames, frames, depth * sizeof(void *));
+                sites[idx].depth = depth;
+                atomic_store_explicit(&sites[idx].ready, 1, memory_order_release);
+                return (uint32_t)idx;
+            }
+            cur = expected;
+        }
+        if (cur == h) return (uint32_t)idx;
+    }
+    return UINT32_MAX;               /* таблица стеков переполнена */
+}
+
+/* Живой выборочный блок: в таблицу и в inuse его стека */
+static void insert_sample(uintptr_t key, size_t size, uint32_t site) {
+    SiteSlot *s = &sites[site];
+    size_t mask = ((size_t)1 << SAMPLE_TABLE_BITS) - 1;
+    for (size_t i = 0, idx = mix64(key) & mask; i <= mask; i++, idx = (idx + 1) & mask) {
+        uintptr_t cur = atomic_load_explicit(&samples[idx].addr, memory_order_relaxed);
+        if (cur != SAMPLE_EMPTY && cur != SAMPLE_TOMB) continue;
+        if (atomic_compare_exchange_strong(&samples[idx].addr, &cur, key)) {
+            samples[idx].size = size;
+            samples[idx].site = site;
+            atomic_fetch_add_explicit(&s->inuse_objs, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&s->inuse_bytes, size, memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+static void record_sample(void *ptr, size_t size, void **frames, int depth) {
+    uint32_t site = intern_site(frames, depth);
+    if (site == UINT32_MAX) return;
+
+    SiteSlot *s = &sites[site];
+    atomic_fetch_add_explicit(&s->alloc_objs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->alloc_bytes, size, memory_order_relaxed);
+    insert_sample((uintptr_t)ptr, size, site);
+}
+
+/* Освобождение: ищем адрес среди выборок (обычно – одна проба до пустого
+ * слота).  1 и размер со стеком, если блок был в выборке */
+static int forget_sample(void *ptr, size_t *size, uint32_t *site) {
+    uintptr_t key = (uintptr_t)ptr;
+    size_t mask = ((size_t)1 << SAMPLE_TABLE_BITS) - 1;
+
+    for (size_t i = 0, idx = mix64(key) & mask; i <= mask; i++, idx = (idx + 1) & mask) {
+        uintptr_t cur = atomic_load_explicit(&samples[idx].addr, memory_order_relaxed);
+        if (cur == SAMPLE_EMPTY) return 0;
+        if (cur == key) {
+            *size = samples[idx].size;
+            *site = samples[idx].site;
+            SiteSlot *s = &sites[*site];
+            atomic_fetch_sub_explicit(&s->inuse_objs, 1, memory_order_relaxed);
+            atomic_fetch_sub_explicit(&s->inuse_bytes, *size, memory_order_relaxed);
+            atomic_store_explicit(&samples[idx].addr, SAMPLE_TOMB, memory_order_relaxed);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void heap_dump(void);
+
+#define MAYBE_SAMPLE(ptr, size)                                     \
+    do {                                                            \
+        if (!(ptr) || in_hook) break;                               \
+        /* первый шаг потока – случайный, как и все следующие: с    \
+         * нулём первое выделение каждого потока попадало бы в      \
+         * выборку и масштабировалось до sample_rate */             \
+        if (!sample_armed) {                                        \
+            if (!ensure_init()) break;                              \
+            sample_armed = 1;                                       \
+            bytes_until_sample = next_sample_interval();            \
+        }                                                           \
+        bytes_until_sample -= (ssize_t)(size);                      \
+        if (bytes_until_sample > 0 &&                               \
+            !atomic_load_explicit(&dump_requested, memory_order_relaxed)) \
+            break;                                                  \
+        if (!ensure_init()) break;                                  \
+        in_hook = 1;                                                \
+        if (bytes_until_sample <= 0) {                              \
+            void *frames_[MAX_FRAMES];                              \
+            int depth_ = unwind(frames_, MAX_FRAMES);               \
+            record_sample((ptr), (size), frames_, depth_);          \
+            bytes_until_sample = next_sample_interval();            \
+        }                                                           \
+        if (atomic_exchange(&dump_requested, 0)) heap_dump();       \
+        in_hook = 0;                                                \
+    } while (0)
+
+/* 1, если ptr был в выборке; его размер и стек – в *size, *site */
+static inline int maybe_forget(void *ptr, size_t *size, uint32_t *site) {
+    return ptr && !in_hook &&
+           atomic_load_explicit(&init_state, memory_order_acquire) == 2 &&
+           forget_sample(ptr, size, site);
+}
+
+/* ---------------------------------------------------------------------- */
+/*  Перехватчики                                                           */
+/* ---------------------------------------------------------------------- */
+
+void *malloc(size_t size) {
+    void *ptr = __libc_malloc(size);
+    MAYBE_SAMPLE(ptr, size);
+    return ptr;
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    void *ptr = __libc_calloc(nmemb, size);
+    MAYBE_SAMPLE(ptr, nmemb * size);
+    return ptr;
+}
+
+void *realloc(void *old, size_t size) {
+    /* old убирается из выборки до realloc: после него адрес может
+     * получить и попасть в выборку другой поток.  Если realloc не
+     * удался (NULL при size != 0), блок жив и возвращается в inuse */
+    size_t old_size;
+    uint32_t old_site;
+    int forgotten = maybe_forget(old, &old_size, &old_site);
+    void *ptr = __libc_realloc(old, size);
+    if (forgotten && !ptr && size != 0) insert_sample((uintptr_t)old, old_size, old_site);
+    MAYBE_SAMPLE(ptr, size);
+    return ptr;
+}
+
+void free(void *ptr) {
+    size_t size;
+    uint32_t site;
+    (void)maybe_forget(ptr, &size, &site);
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    void *ptr = __libc_memalign(alignment, size);
+    MAYBE_SAMPLE(ptr, size);
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    void *ptr = __libc_memalign(alignment, size);
+    MAYBE_SAMPLE(ptr, size);
+    return ptr;
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1))) return 22; /* EINVAL */
+    void *ptr = __libc_memalign(alignment, size);
+    if (!ptr) return 12;                                                     /* ENOMEM */
+    MAYBE_SAMPLE(ptr, size);
+    *out = ptr;
+    return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+/*  Дамп                                                                   */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    int fd;
+    size_t len;
+    char buf[1 << 16];
+} Writer;
+
+static Writer writer;                /* под dump_lock */
+
+static void w_flush(Writer *w) {
+    size_t off = 0;
+    while (off < w->len) {
+        ssize_t n = write(w->fd, w->buf + off, w->len - off);
+        if (n <= 0) break;
+        off += (size_t)n;
+    }
+    w->len = 0;
+}
+
+static void w_printf(Writer *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void w_printf(Writer *w, const char *fmt, ...) {
+    if (sizeof(w->buf) - w->len < 1024) w_flush(w);
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(w->buf + w->len, sizeof(w->buf) - w->len, fmt, ap);
+    va_end(ap);
+    if (n > 0) w->len += (size_t)n < sizeof(w->buf) - w->len ? (size_t)n : sizeof(w->buf) - w->len - 1;
+}
+
+static int w_open(Writer *w, const char *prefix, unsigned seq, const char *suffix) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s.%d.%u.%s", prefix, (int)getpid(), seq, suffix);
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    w->len = 0;
+    return w->fd >= 0;
+}
+
+static void w_close(Writer *w) {
+    w_flush(w);
+    close(w->fd);
+}
+
+/* Оценка полного объёма по выборке – та же формула, что у pprof для heap_v2 */
+static double unsample(size_t objs, size_t bytes) {
+    if (!objs) return 0;
+    double avg = (double)bytes / objs;
+    return bytes / (1.0 - exp(-avg / sample_rate));
+}
+
+static void write_folded(Writer *w, int inuse) {
+    size_t slots = (size_t)1 << SITE_TABLE_BITS;
+    for (size_t i = 0; i < slots; i++) {
+        SiteSlot *s = &sites[i];
+        if (!atomic_load_explicit(&s->ready, memory_order_acquire)) continue;
+        size_t objs = inuse ? atomic_load(&s->inuse_objs) : atomic_load(&s->alloc_objs);
+        size_t bytes = inuse ? atomic_load(&s->inuse_bytes) : atomic_load(&s->alloc_bytes);
+        if (!bytes) continue;
+
+        /* корень слева: от внешнего кадра к месту выделения */
+        for (int f = s->depth - 1; f >= 0; f--) {
+            Dl_info info;
+            const char *sep = f == s->depth - 1 ? "" : ";";
+            if (dladdr(s->frames[f], &info) && info.dli_sname)
+                w_printf(w, "%s%s", sep, info.dli_sname);
+            else
+                w_printf(w, "%s%p", sep, s->frames[f]);
+        }
+        w_printf(w, " %.0f\n", unsample(objs, bytes));
+    }
+}
+
+static void write_pprof(Writer *w) {
+    size_t slots = (size_t)1 << SITE_TABLE_BITS;
+    size_t in_objs = 0, in_bytes = 0, al_objs = 0, al_bytes = 0;
+    for (size_t i = 0; i < slots; i++) {
+        if (!atomic_load_explicit(&sites[i].ready, memory_order_acquire)) continue;
+        in_objs += atomic_load(&sites[i].inuse_objs);
+        in_bytes += atomic_load(&sites[i].inuse_bytes);
+        al_objs += atomic_load(&sites[i].alloc_objs);
+        al_bytes += atomic_load(&sites[i].alloc_bytes);
+    }
+
+    w_printf(w, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%.0f\n",
+             in_objs, in_bytes, al_objs, al_bytes, sample_rate);
+    for (size_t i = 0; i < slots; i++) {
+        SiteSlot *s = &sites[i];
+        if (!atomic_load_explicit(&s->ready, memory_order_acquire)) continue;
+        w_printf(w, "%zu: %zu [%zu: %zu] @",
+                 atomic_load(&s->inuse_objs), atomic_load(&s->inuse_bytes),
+                 atomic_load(&s->alloc_objs), atomic_load(&s->alloc_bytes));
+        for (int f = 0; f < s->depth; f++)
+            w_printf(w, " %p", s->frames[f]);
+        w_printf(w, "\n");
+    }
+
+    /* pprof сопоставляет адреса с модулями по карте памяти процесса */
+    w_printf(w, "\nMAPPED_LIBRARIES:\n");
+    w_flush(w);
+    int maps = open("/proc/self/maps", O_RDONLY);
+    if (maps >= 0) {
+        ssize_t n;
+        while ((n = read(maps, w->buf, sizeof(w->buf))) > 0) {
+            w->len = (size_t)n;
+            w_flush(w);
+        }
+        close(maps);
+    }
+}
+
+static void heap_dump(void) {
+    const char *prefix = getenv("HEAP_SAMPLER_OUT");
+    if (!prefix || !*prefix) prefix = "heap_sampler";
+    unsigned seq = atomic_fetch_add(&dump_seq, 1);
+
+    pthread_mutex_lock(&dump_lock);
+    if (w_open(&writer, prefix, seq, "heap")) {
+        write_pprof(&writer);
+        w_close(&writer);
+    }
+    if (w_open(&writer, prefix, seq, "inuse.folded")) {
+        write_folded(&writer, 1);
+        w_close(&writer);
+    }
+    if (w_open(&writer, prefix, seq, "alloc.folded")) {
+        write_folded(&writer, 0);
+        w_close(&writer);
+    }
+    pthread_mutex_unlock(&dump_lock);
+}
+
+/* В обработчике только взводим флаг: сам дамп выполнит ближайший вызов
+ * malloc в обычном контексте, где dladdr и stdio безопасны. */
+static void on_dump_signal(int sig) {
+    (void)sig;
+    atomic_store(&dump_requested, 1);
+}
+
+__attribute__((constructor))
+static void heap_sampler_init(void) {
+    if (!ensure_init()) return;
+    in_hook = 1;
+
+    const char *rate = getenv("HEAP_SAMPLER_RATE_KB");
+    if (rate && atof(rate) > 0) sample_rate = atof(rate) * 1024.0;
+    bytes_until_sample = next_sample_interval();
+    sample_armed = 1;
+
+    int sig = SIGUSR2;
+    const char *sig_env = getenv("HEAP_SAMPLER_SIGNAL");
+    if (sig_env) sig = atoi(sig_env);
+    if (sig > 0) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_dump_signal;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(sig, &sa, NULL);
+    }
+    in_hook = 0;
+}
+
+__attribute__((destructor))
+static void heap_sampler_fini(void) {
+    if (!ensure_init()) return;
+    in_hook = 1;
+    heap_dump();
+}
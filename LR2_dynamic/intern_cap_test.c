@@ -0,0 +1,129 @@
+/*  intern_cap_test.c
+ *  ─────────────────────────────────────────────────────────────────────
+ *  Проверка поведения Cache, NumaCache и List, когда таблица строк
+ *  (string_intern.h) заполнена и intern() возвращает 0.
+ *
+ *  * Таблица уменьшена до INTERN_MAX_PAGES страниц (по умолчанию 2, то
+ *    есть 2047 строк), и в каждую структуру добавляется заметно больше
+ *    различных ключей.
+ *  * Ключи сверх предела должны сохраняться копией: последний ключ
+ *    находится, обновление ключа-копии не создаёт второй записи,
+ *    отсутствующий ключ не находится, узел списка хранит свою строку.
+ *  * Код возврата 0 – все проверки прошли, 1 – есть ошибки (они
+ *    перечислены в stderr).
+ *
+ *  Компиляция:
+ *      gcc -O2 -g -o intern_cap_test intern_cap_test.c -pthread
+ *      gcc -O2 -g -DINTERN_MAX_PAGES=4096 -o intern_cap_test intern_cap_test.c -pthread
+ *
+ *  Запуск:
+ *      ./intern_cap_test
+ *  ----------------------------------------------------------------------- */
+
+#ifndef INTERN_MAX_PAGES
+#define INTERN_MAX_PAGES 2
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define main prog_1_main
+#include "prog_1_structs_ways.c"
+#undef main
+#define main prog_2_main
+#include "prog_2_files_cache.c"
+#undef main
+
+#define KEYS_PAST_CAP ((long)INTERN_MAX_PAGES * INTERN_PAGE_SIZE + 1000)
+
+static int failures;
+
+#define CHECK(cond, ...)                                            \
+    do {                                                            \
+        if (!(cond)) {                                              \
+            fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__);    \
+            fprintf(stderr, __VA_ARGS__);                           \
+            fprintf(stderr, "\n");                                  \
+            failures++;                                             \
+        }                                                           \
+    } while (0)
+
+static const char *entry_key(const CacheEntry *entry) {
+    return entry->key ? intern_str(entry->key) : entry->key_copy;
+}
+
+static void test_cache(void) {
+    Cache *cache = create_cache(CACHE_SIZE);
+    char key[32], value[32], out[32];
+
+    for (long i = 0; i < KEYS_PAST_CAP; i++) {
+        snprintf(key, sizeof(key), "temp_key_%ld", i);
+        snprintf(value, sizeof(value), "temp_value_%ld", i);
+        add_to_cache(cache, key, value, strlen(value) + 1);
+    }
+    CHECK(intern_refused(), "таблица строк не заполнилась за %ld ключей", KEYS_PAST_CAP);
+
+    snprintf(key, sizeof(key), "temp_key_%ld", KEYS_PAST_CAP - 1);
+    snprintf(value, sizeof(value), "temp_value_%ld", KEYS_PAST_CAP - 1);
+    CHECK(strcmp(entry_key(cache->head), key) == 0,
+          "в голове %s вместо %s", entry_key(cache->head), key);
+    CHECK(cache->count == CACHE_SIZE, "записей %d вместо %d", cache->count, CACHE_SIZE);
+    long size = get_from_cache(cache, key, out, sizeof(out));
+    CHECK(size == (long)strlen(value) + 1 && strcmp(out, value) == 0,
+          "последний ключ %s: размер %ld", key, size);
+
+    /* обновление ключа-копии меняет значение на месте */
+    add_to_cache(cache, key, "updated", 8);
+    CHECK(cache->count == CACHE_SIZE, "обновление добавило запись: %d", cache->count);
+    size = get_from_cache(cache, key, out, sizeof(out));
+    CHECK(size == 8 && strcmp(out, "updated") == 0, "обновлённое значение не найдено");
+
+    /* вытесненный и никогда не добавлявшийся ключи не находятся */
+    snprintf(key, sizeof(key), "temp_key_%ld", KEYS_PAST_CAP - CACHE_SIZE - 1);
+    CHECK(get_from_cache(cache, key, out, sizeof(out)) == -1, "вытесненный %s найден", key);
+    CHECK(get_from_cache(cache, "never_added", out, sizeof(out)) == -1, "never_added найден");
+
+    /* интернированный ключ по-прежнему находится по номеру */
+    add_to_cache(cache, "temp_key_0", "zero", 5);
+    size = get_from_cache(cache, "temp_key_0", out, sizeof(out));
+    CHECK(size == 5 && strcmp(out, "zero") == 0, "интернированный temp_key_0 не найден");
+}
+
+static void test_numa_cache(void) {
+    NumaCache *numa = create_numa_cache(CACHE_SIZE, 1);
+    char out[32];
+
+    add_to_numa_cache(numa, "numa_past_cap", "value", 6);
+    long size = get_from_numa_cache(numa, "numa_past_cap", out, sizeof(out));
+    CHECK(size == 6 && strcmp(out, "value") == 0, "numa_past_cap не найден");
+    add_to_numa_cache(numa, "numa_past_cap", "other", 6);
+    size = get_from_numa_cache(numa, "numa_past_cap", out, sizeof(out));
+    CHECK(size == 6 && strcmp(out, "other") == 0, "обновление numa_past_cap не видно");
+}
+
+static void test_list(void) {
+    List *list = create_list();
+    char data[32];
+
+    for (long i = 0; i < KEYS_PAST_CAP; i++) {
+        snprintf(data, sizeof(data), "node_data_%ld", i);
+        add_node(list, (int)i, data);
+    }
+    CHECK(list->size == KEYS_PAST_CAP, "узлов %d вместо %ld", list->size, KEYS_PAST_CAP);
+    snprintf(data, sizeof(data), "node_data_%ld", KEYS_PAST_CAP - 1);
+    CHECK(list->tail && strcmp(node_data(list->tail), data) == 0,
+          "в хвосте %s вместо %s", list->tail ? node_data(list->tail) : "(нет)", data);
+    CHECK(remove_node_by_id(list, (int)(KEYS_PAST_CAP - 1)) == 0, "узел-копия не удалён");
+    destroy_list_partial(list);
+    free(list);
+}
+
+int main(void) {
+    test_cache();
+    test_numa_cache();
+    test_list();
+    printf("intern_cap_test: %ld ключей при пределе %u строк, ошибок: %d\n",
+           KEYS_PAST_CAP, (unsigned)INTERN_MAX_PAGES * INTERN_PAGE_SIZE - 1, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,514 @@
+/*  leak_tracker.c
+ *  ─────────────────────────────────────────────────────────────────────
+ *  Лёгкий трекер утечек, подгружаемый через LD_PRELOAD, – быстрая
+ *  альтернатива `valgrind --leak-check=full` для нагрузочных прогонов.
+ *
+ *  * Перехватывает malloc/calloc/realloc/free (и выровненные варианты),
+ *    реальное выделение выполняет glibc (__libc_malloc и т.д.).
+ *  * Место вызова запоминается раскруткой по frame pointer'ам –
+ *    программа должна быть собрана с -fno-omit-frame-pointer
+ *    (при -O0 это и так по умолчанию).
+ *  * Живые блоки и стеки хранятся в lock-free хеш-таблицах с открытой
+ *    адресацией, память под них берётся через mmap, а не из кучи.
+ *  * При завершении процесса корни (записываемые сегменты всех модулей
+ *    и живая часть стека) сканируются как в memcheck, и печатается
+ *    отчёт в стиле Valgrind: definitely / indirectly / possibly lost и
+ *    still reachable.
+ *
+ *  Компиляция:
+ *      gcc -O2 -g -shared -fPIC -fno-omit-frame-pointer \
+ *          -o libleak_tracker.so leak_tracker.c -ldl -pthread
+ *
+ *  Запуск (-rdynamic нужен, чтобы в отчёте были имена функций):
+ *      gcc -g -rdynamic -fno-omit-frame-pointer \
+ *          -o prog_2_files_cache prog_2_files_cache.c -pthread
+ *      LD_PRELOAD=./libleak_tracker.so ./prog_2_files_cache 1
+ *
+ *  Переменные окружения:
+ *      LEAK_TRACKER_LOG=<file>        – писать отчёт в файл, а не в stderr
+ *      LEAK_TRACKER_SHOW_REACHABLE=1  – показывать still reachable блоки
+ *                                       (аналог --show-leak-kinds=all)
+ *  ----------------------------------------------------------------------- */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <link.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "preload_hooks.h"
+
+#define MAX_FRAMES       12          /* как --num-callers=12 у Valgrind */
+#define BLOCK_TABLE_BITS 20          /* до ~1M одновременно живых блоков */
+#define SITE_TABLE_BITS  16          /* до 64K различных мест выделения */
+
+#define BLOCK_EMPTY ((uintptr_t)0)
+#define BLOCK_TOMB  ((uintptr_t)1)
+
+/* ---------------------------------------------------------------------- */
+/*  Таблицы                                                                */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    _Atomic uintptr_t addr;          /* BLOCK_EMPTY / BLOCK_TOMB / адрес */
+    size_t size;
+    uint32_t site;
+} BlockSlot;
+
+typedef struct {
+    _Atomic uint64_t hash;           /* 0 – слот свободен */
+    _Atomic int ready;               /* кадры записаны */
+    int depth;
+    void *frames[MAX_FRAMES + 1];    /* [0] – сама функция-аллокатор */
+} SiteSlot;
+
+static BlockSlot *blocks;
+static SiteSlot *sites;
+static _Atomic int init_state;       /* 0 – нет, 1 – идёт, 2 – готово */
+
+/* Счётчики ведутся по потокам без lock-префикса и суммируются в отчёте;
+ * потоки сверх MAX_THREADS делят последний слот с атомарным сложением */
+#define MAX_THREADS 1024
+
+typedef struct {
+    _Atomic size_t allocs;
+    _Atomic size_t frees;
+    _Atomic size_t bytes;
+} Counters;
+
+static Counters counters[MAX_THREADS];
+static _Atomic size_t next_counter;
+static _Atomic size_t dropped;       /* блоки, не поместившиеся в таблицу */
+
+static HOOK_TLS int in_hook;
+static HOOK_TLS Counters *my_counters;
+
+static inline void count(_Atomic size_t *field, size_t delta, Counters *c) {
+    if (c == &counters[MAX_THREADS - 1])
+        atomic_fetch_add_explicit(field, delta, memory_order_relaxed);
+    else
+        atomic_store_explicit(field, atomic_load_explicit(field, memory_order_relaxed) + delta,
+                              memory_order_relaxed);
+}
+
+static Counters *thread_counters(void) {
+    if (!my_counters) {
+        size_t idx = atomic_fetch_add(&next_counter, 1);
+        my_counters = &counters[idx < MAX_THREADS ? idx : MAX_THREADS - 1];
+    }
+    return my_counters;
+}
+
+static int ensure_init(void) {
+    int state = atomic_load_explicit(&init_state, memory_order_acquire);
+    if (state == 2) return 1;
+
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&init_state, &expected, 1)) {
+        blocks = map_zeroed(sizeof(BlockSlot) << BLOCK_TABLE_BITS);
+        sites = map_zeroed(sizeof(SiteSlot) << SITE_TABLE_BITS);
+        atomic_store_explicit(&init_state, 2, memory_order_release);
+    }
+    while (atomic_load_explicit(&init_state, memory_order_acquire) != 2)
+        ;
+    return blocks && sites;
+}
+
+static uint32_t intern_site(void *allocator, void **frames, int depth) {
+    uint64_t h = mix64((uintptr_t)allocator);
+    for (int i = 0; i < depth; i++)
+        h = mix64(h ^ (uintptr_t)frames[i]);
+    if (h == 0) h = 1;
+
+    size_t mask = ((size_t)1 << SITE_TABLE_BITS) - 1;
+    for (size_t i = 0, idx = h & mask; i <= mask; i++, idx = (idx + 1) & mask) {
+        uint64_t cur = atomic_load_explicit(&sites[idx].hash, memory_order_acquire);
+        if (cur == 0) {
+            uint64_t expected = 0;
+            if (atomic_compare_exchange_strong(&sites[idx].hash, &expected, h)) {
+                sites[idx].frames[0] = allocator;
+                memcpy(&sites[idx].frames[1], frames, depth * sizeof(void *));
+                sites[idx].depth = depth + 1;
+                atomic_store_explicit(&sites[idx].ready, 1, memory_order_release);
+                return (uint32_t)idx;
+            }
+            cur = expected;
+        }
+        if (cur == h) return (uint32_t)idx;
+    }
+    return UINT32_MAX;               /* таблица мест переполнена */
+}
+
+static void insert_block(uintptr_t key, size_t size, uint32_t site) {
+    size_t mask = ((size_t)1 << BLOCK_TABLE_BITS) - 1;
+    for (size_t i = 0, idx = mix64(key) & mask; i <= mask; i++, idx = (idx + 1) & mask) {
+        uintptr_t cur = atomic_load_explicit(&blocks[idx].addr, memory_order_relaxed);
+        if (cur != BLOCK_EMPTY && cur != BLOCK_TOMB) continue;
+        if (atomic_compare_exchange_strong(&blocks[idx].addr, &cur, key)) {
+            blocks[idx].size = size;
+            blocks[idx].site = site;
+            return;
+        }
+    }
+    atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+}
+
+static void track_block(void *ptr, size_t size, void *allocator, void **frames, int depth) {
+    uint32_t site = intern_site(allocator, frames, depth);
+
+    Counters *c = thread_counters();
+    count(&c->allocs, 1, c);
+    count(&c->bytes, size, c);
+    insert_block((uintptr_t)ptr, size, site);
+}
+
+/* Убирает блок из таблицы, не считая free; 1 и его размер и место, если
+ * блок отслеживался */
+static int detach_block(void *ptr, size_t *size, uint32_t *site) {
+    uintptr_t key = (uintptr_t)ptr;
+    size_t mask = ((size_t)1 << BLOCK_TABLE_BITS) - 1;
+
+    for (size_t i = 0, idx = mix64(key) & mask; i <= mask; i++, idx = (idx + 1) & mask) {
+        uintptr_t cur = atomic_load_explicit(&blocks[idx].addr, memory_order_relaxed);
+        if (cur == BLOCK_EMPTY) return 0;        /* блок не отслеживался */
+        if (cur == key) {
+            *size = blocks[idx].size;
+            *site = blocks[idx].site;
+            atomic_store_explicit(&blocks[idx].addr, BLOCK_TOMB, memory_order_relaxed);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void count_free(void) {
+    Counters *c = thread_counters();
+    count(&c->frees, 1, c);
+}
+
+static void untrack_block(void *ptr) {
+    size_t size;
+    uint32_t site;
+    if (detach_block(ptr, &size, &site)) count_free();
+}
+
+/* ---------------------------------------------------------------------- */
+/*  Перехватчики                                                           */
+/* ---------------------------------------------------------------------- */
+
+#define RECORD_ALLOC(ptr, size, allocator)                          \
+    do {                                                            \
+        if ((ptr) && !in_hook && ensure_init()) {                   \
+            void *frames_[MAX_FRAMES];                              \
+            in_hook = 1;                                            \
+            int depth_ = unwind(frames_, MAX_FRAMES);               \
+            track_block((ptr), (size), (void *)(allocator),         \
+                        frames_, depth_);                           \
+            in_hook = 0;                                            \
+        }                                                           \
+    } while (0)
+
+void *malloc(size_t size) {
+    void *ptr = __libc_malloc(size);
+    RECORD_ALLOC(ptr, size, malloc);
+    return ptr;
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    void *ptr = __libc_calloc(nmemb, size);
+    RECORD_ALLOC(ptr, nmemb * size, calloc);
+    return ptr;
+}
+
+void *realloc(void *old, size_t size) {
+    /* old снимается с учёта до realloc: после него адрес уже может
+     * выдать malloc другого потока, и в таблице оказались бы два
+     * одинаковых ключа.  Если realloc не удался (NULL при size != 0),
+     * старый блок жив – он возвращается с тем же местом и размером, и
+     * его утечка попадёт в отчёт.  realloc(old, 0) в glibc освобождает
+     * блок и тоже возвращает NULL */
+    size_t old_size = 0;
+    uint32_t old_site = 0;
+    int detached = old && !in_hook && ensure_init() && detach_block(old, &old_size, &old_site);
+    void *ptr = __libc_realloc(old, size);
+    if (detached) {
+        if (ptr || size == 0) count_free();
+        else insert_block((uintptr_t)old, old_size, old_site);
+    }
+    RECORD_ALLOC(ptr, size, realloc);
+    return ptr;
+}
+
+void free(void *ptr) {
+    if (ptr && !in_hook && ensure_init()) untrack_block(ptr);
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    void *ptr = __libc_memalign(alignment, size);
+    RECORD_ALLOC(ptr, size, memalign);
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    void *ptr = __libc_memalign(alignment, size);
+    RECORD_ALLOC(ptr, size, aligned_alloc);
+    return ptr;
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1))) return 22; /* EINVAL */
+    void *ptr = __libc_memalign(alignment, size);
+    if (!ptr) return 12;                                                     /* ENOMEM */
+    RECORD_ALLOC(ptr, size, posix_memalign);
+    *out = ptr;
+    return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+/*  Поиск утечек при завершении                                            */
+/* ---------------------------------------------------------------------- */
+
+enum { LOST_DEFINITE, LOST_INDIRECT, LOST_POSSIBLE, STILL_REACHABLE, KIND_COUNT, UNREACHED };
+
+static const char *kind_names[KIND_COUNT] = {
+    "definitely lost", "indirectly lost", "possibly lost", "still reachable",
+};
+
+typedef struct {
+    uintptr_t addr;
+    size_t size;
+    uint32_t site;
+    int kind;
+} LiveBlock;
+
+typedef struct {
+    uint32_t site;
+    int kind;
+    size_t bytes;
+    size_t count;
+} LossRecord;
+
+static LiveBlock *live;
+static size_t live_count;
+static size_t *worklist;
+static size_t worklist_len;
+static int report_fd = 2;
+
+static void report(const char *fmt, ...) {
+    char line[512];
+    int off = snprintf(line, sizeof(line), "==%d== ", (int)getpid());
+    va_list ap;
+    va_start(ap, fmt);
+    off += vsnprintf(line + off, sizeof(line) - off, fmt, ap);
+    va_end(ap);
+    if (off > (int)sizeof(line) - 2) off = sizeof(line) - 2;
+    line[off++] = '\n';
+    ssize_t unused = write(report_fd, line, off);
+    (void)unused;
+}
+
+static int cmp_live(const void *a, const void *b) {
+    uintptr_t x = ((const LiveBlock *)a)->addr, y = ((const LiveBlock *)b)->addr;
+    return (x > y) - (x < y);
+}
+
+static int cmp_record(const void *a, const void *b) {
+    const LossRecord *x = a, *y = b;
+    if (x->kind != y->kind) return x->kind - y->kind;
+    if (x->bytes != y->bytes) return (x->bytes > y->bytes) - (x->bytes < y->bytes);
+    return (x->site > y->site) - (x->site < y->site);
+}
+
+/* Блок, в который попадает значение word, или -1 */
+static ssize_t find_block(uintptr_t word, int *interior) {
+    size_t lo = 0, hi = live_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (word < live[mid].addr) hi = mid;
+        else if (word >= live[mid].addr + (live[mid].size ? live[mid].size : 1)) lo = mid + 1;
+        else {
+            *interior = word != live[mid].addr;
+            return (ssize_t)mid;
+        }
+    }
+    return -1;
+}
+
+/* Помечает блоки, на которые указывают слова из [begin, end) */
+static void scan_range(uintptr_t begin, uintptr_t end, int from_kind, size_t leader) {
+    begin = (begin + 7) & ~(uintptr_t)7;
+    for (uintptr_t p = begin; p + sizeof(uintptr_t) <= end; p += sizeof(uintptr_t)) {
+        int interior = 0;
+        ssize_t idx = find_block(*(uintptr_t *)p, &interior);
+        if (idx < 0 || (size_t)idx == leader) continue;
+
+        LiveBlock *b = &live[idx];
+        int kind;
+        if (from_kind == LOST_INDIRECT) {
+            /* блок, достижимый только из потерянных блоков */
+            if (b->kind != UNREACHED && b->kind != LOST_DEFINITE) continue;
+            kind = LOST_INDIRECT;
+        } else {
+            /* внутренний указатель или путь через possibly – possibly lost */
+            kind = (from_kind == STILL_REACHABLE && !interior) ? STILL_REACHABLE : LOST_POSSIBLE;
+            if (b->kind == STILL_REACHABLE || b->kind == kind) continue;
+        }
+        b->kind = kind;
+        worklist[worklist_len++] = (size_t)idx;
+    }
+}
+
+static void drain_worklist(size_t leader) {
+    while (worklist_len) {
+        LiveBlock *b = &live[worklist[--worklist_len]];
+        scan_range(b->addr, b->addr + b->size, b->kind, leader);
+    }
+}
+
+static int scan_segment(struct dl_phdr_info *info, size_t size, void *data) {
+    (void)size; (void)data;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+        if (ph->p_type != PT_LOAD || !(ph->p_flags & PF_W)) continue;
+        uintptr_t start = info->dlpi_addr + ph->p_vaddr;
+        scan_range(start, start + ph->p_memsz, STILL_REACHABLE, SIZE_MAX);
+        drain_worklist(SIZE_MAX);
+    }
+    return 0;
+}
+
+static void print_frame(const char *prefix, void *pc) {
+    Dl_info info;
+    if (dladdr(pc, &info) && info.dli_fname) {
+        const char *module = strrchr(info.dli_fname, '/');
+        module = module ? module + 1 : info.dli_fname;
+        report("   %s %p: %s (%s+0x%lx)", prefix, pc,
+               info.dli_sname ? info.dli_sname : "???", module,
+               (unsigned long)((uintptr_t)pc - (uintptr_t)info.dli_fbase));
+    } else {
+        report("   %s %p: ???", prefix, pc);
+    }
+}
+
+static void classify_blocks(void) {
+    /* Корни: записываемые сегменты модулей и живая часть стека */
+    dl_iterate_phdr(scan_segment, NULL);
+    uintptr_t sp = (uintptr_t)__builtin_frame_address(0);
+    if (current_stack_hi() > sp) {
+        scan_range(sp, current_stack_hi(), STILL_REACHABLE, SIZE_MAX);
+        drain_worklist(SIZE_MAX);
+    }
+
+    /* Недостижимые блоки: «лидеры» – definitely lost, всё, что
+     * достижимо только из них, – indirectly lost */
+    for (size_t i = 0; i < live_count; i++) {
+        if (live[i].kind != UNREACHED) continue;
+        live[i].kind = LOST_DEFINITE;
+        scan_range(live[i].addr, live[i].addr + live[i].size, LOST_INDIRECT, i);
+        drain_worklist(i);
+    }
+}
+
+static void leak_report(void) {
+    size_t slots = (size_t)1 << BLOCK_TABLE_BITS;
+    for (size_t i = 0; i < slots; i++) {
+        uintptr_t a = atomic_load_explicit(&blocks[i].addr, memory_order_relaxed);
+        if (a != BLOCK_EMPTY && a != BLOCK_TOMB) live_count++;
+    }
+
+    live = map_zeroed((live_count + 1) * sizeof(LiveBlock));
+    worklist = map_zeroed((live_count + 1) * sizeof(size_t));
+    LossRecord *records = map_zeroed((live_count + 1) * sizeof(LossRecord));
+    if (!live || !worklist || !records) return;
+
+    size_t n = 0, live_bytes = 0;
+    for (size_t i = 0; i < slots && n < live_count; i++) {
+        uintptr_t a = atomic_load_explicit(&blocks[i].addr, memory_order_relaxed);
+        if (a == BLOCK_EMPTY || a == BLOCK_TOMB) continue;
+        live[n] = (LiveBlock){ a, blocks[i].size, blocks[i].site, UNREACHED };
+        live_bytes += blocks[i].size;
+        n++;
+    }
+    live_count = n;
+    qsort(live, live_count, sizeof(LiveBlock), cmp_live);
+    classify_blocks();
+
+    /* Группируем блоки в записи по (вид, место выделения) */
+    size_t nrec = 0;
+    size_t kind_bytes[KIND_COUNT] = {0}, kind_blocks[KIND_COUNT] = {0};
+    for (size_t i = 0; i < live_count; i++) {
+        kind_bytes[live[i].kind] += live[i].size;
+        kind_blocks[live[i].kind]++;
+        size_t r = 0;
+        while (r < nrec && (records[r].site != live[i].site || records[r].kind != live[i].kind))
+            r++;
+        if (r == nrec) records[nrec++] = (LossRecord){ live[i].site, live[i].kind, 0, 0 };
+        records[r].bytes += live[i].size;
+        records[r].count++;
+    }
+    qsort(records, nrec, sizeof(LossRecord), cmp_record);
+
+    const char *show = getenv("LEAK_TRACKER_SHOW_REACHABLE");
+    int show_reachable = show && *show == '1';
+
+    size_t total_allocs = 0, total_frees = 0, total_bytes = 0;
+    for (size_t i = 0; i < MAX_THREADS; i++) {
+        total_allocs += atomic_load(&counters[i].allocs);
+        total_frees += atomic_load(&counters[i].frees);
+        total_bytes += atomic_load(&counters[i].bytes);
+    }
+
+    report("");
+    report("HEAP SUMMARY:");
+    report("    in use at exit: %zu bytes in %zu blocks", live_bytes, live_count);
+    report("  total heap usage: %zu allocs, %zu frees, %zu bytes allocated",
+           total_allocs, total_frees, total_bytes);
+    report("");
+
+    for (size_t r = 0; r < nrec; r++) {
+        if (records[r].kind == STILL_REACHABLE && !show_reachable) continue;
+        report("%zu bytes in %zu blocks are %s in loss record %zu of %zu",
+               records[r].bytes, records[r].count, kind_names[records[r].kind], r + 1, nrec);
+        SiteSlot *s = records[r].site == UINT32_MAX ? NULL : &sites[records[r].site];
+        if (s && atomic_load(&s->ready)) {
+            for (int f = 0; f < s->depth; f++)
+                print_frame(f == 0 ? "at" : "by", s->frames[f]);
+        }
+        report("");
+    }
+
+    report("LEAK SUMMARY:");
+    for (int k = 0; k < KIND_COUNT; k++)
+        report("   %s: %zu bytes in %zu blocks", kind_names[k], kind_bytes[k], kind_blocks[k]);
+    if (atomic_load(&dropped))
+        report("   untracked (table full): %zu blocks", atomic_load(&dropped));
+    report("");
+}
+
+__attribute__((constructor))
+static void leak_tracker_init(void) {
+    ensure_init();
+}
+
+__attribute__((destructor))
+static void leak_tracker_fini(void) {
+    if (!ensure_init()) return;
+    in_hook = 1;                 /* дальнейшие выделения не отслеживаем */
+
+    const char *path = getenv("LEAK_TRACKER_LOG");
+    if (path && *path) {
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) report_fd = fd;
+    }
+    leak_report();
+    if (report_fd != 2) close(report_fd);
+}
@@ -0,0 +1,541 @@
+/*  microbench.c
+ *  ─────────────────────────────────────────────────────────────────────
+ *  Микробенчмарки структур данных и файловых операций из
+ *  prog_1_structs_ways.c и prog_2_files_cache.c.
+ *
+ *  * Исходники программ подключаются целиком, их main переименовывается.
+ *    Сам бенчмарк определяет malloc, calloc и realloc (поверх
+ *    __libc_malloc и т.п., как preload_hooks.h), поэтому считаются все
+ *    выделения, в том числе внутри libc (FILE и буфер fopen).  Счётчик
+ *    – у потока, и в allocs_per_op входит только замеряемая часть
+ *    теста, без setup/teardown и самого бенчмарка.
+ *  * Поток закрепляется за одним ядром, каждый тест сначала прогревается,
+ *    затем повторяется --repeat раз по batch операций.  Внутри партии
+ *    отдельно замеряется каждая группа из --sample-ops операций (по
+ *    умолчанию каждая операция), из времени вычитается стоимость
+ *    самого замера; перцентили считаются по этим замерам, поэтому p99 –
+ *    действительно хвост отдельных операций.  Тесты, у которых партия –
+ *    одна неделимая операция (whole), дают один замер на повтор;
+ *    sample_ops в отчёте показывает, сколько операций в одном замере.
+ *  * Результат – JSON в stdout, по одному тесту на строку.  С --baseline
+ *    медиана каждого теста сравнивается с прошлым прогоном, и при
+ *    замедлении больше --threshold процентов код возврата равен 1.
+ *
+ *  Утечки из исходных программ сохраняются, поэтому размеры партий
+ *  подобраны так, чтобы полный прогон занимал десятки мегабайт.
+ *
+ *  Компиляция:
+ *      gcc -O2 -g -o microbench microbench.c -pthread
+ *
+ *  Запуск:
+ *      ./microbench > bench.json
+ *      ./microbench --filter cache --baseline bench.json --threshold 10
+ *  ----------------------------------------------------------------------- */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ---------------------------------------------------------------------- */
+/*  Проверяемый код                                                        */
+/* ---------------------------------------------------------------------- */
+
+/* Перехват аллокатора glibc в самом исполняемом файле: вызовы из libc
+ * (fopen, strdup, ...) тоже приходят сюда */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static __thread size_t bench_allocs;
+
+void *malloc(size_t size) {
+    bench_allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    bench_allocs++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    bench_allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+#define main prog_1_main
+#include "prog_1_structs_ways.c"
+#undef main
+#define main prog_2_main
+#include "prog_2_files_cache.c"
+#undef main
+
+/* Специализированные варианты кэша для сравнения с Cache: ключи 8 и
+ * 16 байт, значение 16 байт */
+#include "fixed_cache.h"
+
+typedef struct { uint64_t hi, lo; } BenchKey16;
+typedef struct { char bytes[16]; } BenchValue16;
+
+FIXED_CACHE_DEFINE(fixed_cache_k8, uint64_t, BenchValue16)
+FIXED_CACHE_DEFINE(fixed_cache_k16, BenchKey16, BenchValue16)
+
+/* ---------------------------------------------------------------------- */
+/*  Описание тестов                                                        */
+/* ---------------------------------------------------------------------- */
+
+typedef struct bench {
+    const char *name;
+    size_t batch;                              /* операций в одном повторе */
+    void (*setup)(const struct bench *b);      /* перед замером, не входит во время */
+    void (*run)(const struct bench *b, size_t begin, size_t end);  /* операции [begin, end) */
+    void (*teardown)(const struct bench *b);   /* после замера */
+    int arg1, arg2;
+    int whole;                                 /* 1 – run не делится на операции */
+} Bench;
+
+#define MAX_KEYS 4096
+
+static List *bench_list;
+static Cache *bench_cache;
+static fixed_cache_k8 *bench_fixed_k8;
+static fixed_cache_k16 *bench_fixed_k16;
+static char bench_keys[MAX_KEYS][20];
+static char bench_value[4096];
+static int bench_sequence[1 << 16];
+static char small_file[64], large_file[64];
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* ---------- список ---------- */
+
+static void list_create(const Bench *b) {
+    (void)b;
+    bench_list = create_list();
+}
+
+static void list_fill(const Bench *b) {
+    bench_list = create_list();
+    for (size_t i = 0; i < b->batch; i++)
+        add_node(bench_list, (int)i, "Important data");
+}
+
+static void list_destroy(const Bench *b) {
+    (void)b;
+    if (bench_list) destroy_list_partial(bench_list);
+    free(bench_list);
+    bench_list = NULL;
+}
+
+/* после run_destroy_list узлы уже освобождены, остаётся сама структура */
+static void list_free(const Bench *b) {
+    (void)b;
+    free(bench_list);
+    bench_list = NULL;
+}
+
+static void run_add_node(const Bench *b, size_t begin, size_t end) {
+    (void)b;
+    for (size_t i = begin; i < end; i++)
+        add_node(bench_list, (int)i, "Important data");
+}
+
+static void run_remove_node(const Bench *b, size_t begin, size_t end) {
+    (void)b;
+    for (size_t i = begin; i < end; i++)
+        remove_node_by_id(bench_list, (int)i);
+}
+
+/* одна операция на всю партию – у теста whole = 1 */
+static void run_destroy_list(const Bench *b, size_t begin, size_t end) {
+    (void)b;
+    (void)begin;
+    (void)end;
+    destroy_list_partial(bench_list);
+}
+
+/* ---------- кэш ---------- */
+
+/* arg1 – размер значения, arg2 – ключей на одну ячейку кэша, умноженное
+ * на 10: 10 – все ключи помещаются (почти одни попадания), 100 – в кэш
+ * влезает десятая часть ключей */
+#define BENCH_CACHE_SIZE 64
+
+static void cache_setup(const Bench *b) {
+    int universe = BENCH_CACHE_SIZE * b->arg2 / 10;
+    if (universe > MAX_KEYS) universe = MAX_KEYS;
+    bench_cache = create_cache(BENCH_CACHE_SIZE);
+    for (int i = 0; i < universe && i < BENCH_CACHE_SIZE; i++)
+        add_to_cache(bench_cache, bench_keys[i], bench_value, (size_t)b->arg1);
+    for (size_t i = 0; i < b->batch; i++)
+        bench_sequence[i] = (int)(next_random() % (uint64_t)universe);
+}
+
+/* синхронная база для тестов ниже: вытесненная запись освобождается
+ * целиком под блокировкой, а не утекает, как в create_cache */
+static void cache_setup_sync_free(const Bench *b) {
+    cache_setup(b);
+    bench_cache->free_evicted = 1;
+}
+
+/* то же с фоновым потоком освобождения; arg2 >= 20, так что ключей
+ * больше, чем мест, и вставки вытесняют */
+static void cache_setup_async(const Bench *b) {
+    cache_setup(b);
+    cache_start_reclaimer(bench_cache, 0);
+}
+
+static void cache_setup_preevict(const Bench *b) {
+    cache_setup(b);
+    cache_start_reclaimer(bench_cache, BENCH_CACHE_SIZE * 3 / 4);
+}
+
+static void cache_teardown(const Bench *b) {
+    (void)b;
+    cache_stop_reclaimer(bench_cache);
+    CacheEntry *e = bench_cache->head;
+    while (e) {
+        CacheEntry *next = e->next;
+        free(e->data);
+        free(e);
+        e = next;
+    }
+    pthread_mutex_destroy(&bench_cache->lock);
+    free(bench_cache);
+    bench_cache = NULL;
+}
+
+static void run_add_to_cache(const Bench *b, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+        add_to_cache(bench_cache, bench_keys[bench_sequence[i]], bench_value, (size_t)b->arg1);
+}
+
+static void run_get_from_cache(const Bench *b, size_t begin, size_t end) {
+    static char out[4096];
+    for (size_t i = begin; i < end; i++)
+        get_from_cache(bench_cache, bench_keys[bench_sequence[i]], out, (size_t)b->arg1);
+}
+
+static void run_intern(const Bench *b, size_t begin, size_t end) {
+    (void)b;
+    for (size_t i = begin; i < end; i++)
+        intern(bench_keys[bench_sequence[i]]);
+}
+
+/* ---------- специализированный кэш ---------- */
+
+/* Те же размеры и последовательность ключей, что у тестов cache/add/16B;
+ * ключ – номер из bench_sequence */
+static void fixed_setup(const Bench *b) {
+    int universe = BENCH_CACHE_SIZE * b->arg2 / 10;
+    if (universe > MAX_KEYS) universe = MAX_KEYS;
+    BenchValue16 value;
+    memcpy(value.bytes, bench_value, sizeof(value.bytes));
+    bench_fixed_k8 = fixed_cache_k8_create(BENCH_CACHE_SIZE);
+    bench_fixed_k16 = fixed_cache_k16_create(BENCH_CACHE_SIZE);
+    for (int i = 0; i < universe && i < BENCH_CACHE_SIZE; i++) {
+        uint64_t k8 = (uint64_t)i;
+        BenchKey16 k16 = { 0, (uint64_t)i };
+        fixed_cache_k8_put(bench_fixed_k8, &k8, &value);
+        fixed_cache_k16_put(bench_fixed_k16, &k16, &value);
+    }
+    for (size_t i = 0; i < b->batch; i++)
+        bench_sequence[i] = (int)(next_random() % (uint64_t)universe);
+}
+
+static void fixed_teardown(const Bench *b) {
+    (void)b;
+    fixed_cache_k8_destroy(bench_fixed_k8);
+    fixed_cache_k16_destroy(bench_fixed_k16);
+    bench_fixed_k8 = NULL;
+    bench_fixed_k16 = NULL;
+}
+
+static void run_fixed_put_k8(const Bench *b, size_t begin, size_t end) {
+    (void)b;
+    BenchValue16 value;
+    memcpy(value.bytes, bench_value, sizeof(value.bytes));
+    for (size_t i = begin; i < end; i++) {
+        uint64_t key = (uint64_t)bench_sequence[i];
+        fixed_cache_k8_put(bench_fixed_k8, &key, &value);
+    }
+}
+
+static void run_fixed_put_k16(const Bench *b, size_t begin, size_t end) {
+    (void)b;
+    BenchValue16 value;
+    memcpy(value.bytes, bench_value, sizeof(value.bytes));
+    for (size_t i = begin; i < end; i++) {
+        BenchKey16 key = { 0, (uint64_t)bench_sequence[i] };
+        fixed_cache_k16_put(bench_fixed_k16, &key, &value);
+    }
+}
+
+static void run_fixed_get_k8(const Bench *b, size_t begin, size_t end) {
+    (void)b;
+    static BenchValue16 out;
+    for (size_t i = begin; i < end; i++) {
+        uint64_t key = (uint64_t)bench_sequence[i];
+        fixed_cache_k8_get(bench_fixed_k8, &key, &out);
+    }
+}
+
+/* ---------- файлы, scratch-буферы и циклический буфер ---------- */
+
+static void run_process_file(const Bench *b, size_t begin, size_t end) {
+    const char *path = b->arg1 ? large_file : small_file;
+    for (size_t i = begin; i < end; i++)
+        process_file_with_leak(path);
+}
+
+static void run_conditional(const Bench *b, size_t begin, size_t end) {
+    (void)b;
+    for (size_t i = begin; i < end; i++)
+        conditional_memory_operation((int)(i & 1), (int)(i & 2));
+}
+
+static void run_recursive(const Bench *b, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+        recursive_leak(0, b->arg1);
+}
+
+static void run_circular_buffer(const Bench *b, size_t begin, size_t end) {
+    (void)b;
+    for (size_t i = begin; i < end; i++)
+        circular_buffer_leak();
+}
+
+static const Bench benches[] = {
+    { "list/add_node",              1000, list_create, run_add_node,     list_destroy, 0, 0, 0 },
+    { "list/remove_node_by_id",     1000, list_fill,   run_remove_node,  list_destroy, 0, 0, 0 },
+    { "list/destroy_list_partial",  1000, list_fill,   run_destroy_list, list_free,    0, 0, 1 },
+    { "cache/add/16B/hit",          1000, cache_setup, run_add_to_cache, cache_teardown, 16, 10, 0 },
+    { "cache/add/16B/miss50",       1000, cache_setup, run_add_to_cache, cache_teardown, 16, 20, 0 },
+    { "cache/add/16B/miss90",       1000, cache_setup, run_add_to_cache, cache_teardown, 16, 100, 0 },
+    { "cache/add/256B/hit",         1000, cache_setup, run_add_to_cache, cache_teardown, 256, 10, 0 },
+    { "cache/add/256B/miss90",      1000, cache_setup, run_add_to_cache, cache_teardown, 256, 100, 0 },
+    { "cache/add/1KB/hit",          1000, cache_setup, run_add_to_cache, cache_teardown, 1024, 10, 0 },
+    { "cache/add/1KB/miss90",       1000, cache_setup, run_add_to_cache, cache_teardown, 1024, 100, 0 },
+    { "cache/add/256B/miss90/sync_free", 1000, cache_setup_sync_free, run_add_to_cache, cache_teardown, 256, 100, 0 },
+    { "cache/add/256B/miss90/async",    1000, cache_setup_async,    run_add_to_cache, cache_teardown, 256, 100, 0 },
+    { "cache/add/256B/miss90/preevict", 1000, cache_setup_preevict, run_add_to_cache, cache_teardown, 256, 100, 0 },
+    { "cache/get/16B/hit",          1000, cache_setup, run_get_from_cache, cache_teardown, 16, 10, 0 },
+    { "cache/get/16B/miss90",       1000, cache_setup, run_get_from_cache, cache_teardown, 16, 100, 0 },
+    { "fixed/add/k8/16B/hit",       1000, fixed_setup, run_fixed_put_k8,  fixed_teardown, 16, 10, 0 },
+    { "fixed/add/k8/16B/miss50",    1000, fixed_setup, run_fixed_put_k8,  fixed_teardown, 16, 20, 0 },
+    { "fixed/add/k8/16B/miss90",    1000, fixed_setup, run_fixed_put_k8,  fixed_teardown, 16, 100, 0 },
+    { "fixed/add/k16/16B/hit",      1000, fixed_setup, run_fixed_put_k16, fixed_teardown, 16, 10, 0 },
+    { "fixed/add/k16/16B/miss90",   1000, fixed_setup, run_fixed_put_k16, fixed_teardown, 16, 100, 0 },
+    { "fixed/get/k8/16B/hit",       1000, fixed_setup, run_fixed_get_k8,  fixed_teardown, 16, 10, 0 },
+    { "fixed/get/k8/16B/miss90",    1000, fixed_setup, run_fixed_get_k8,  fixed_teardown, 16, 100, 0 },
+    { "intern/repeat",              1000, cache_setup, run_intern,       cache_teardown, 16, 100, 0 },
+    { "file/process/small",          200, NULL,        run_process_file, NULL, 0, 0, 0 },
+    { "file/process/large",          200, NULL,        run_process_file, NULL, 1, 0, 0 },
+    { "scratch/conditional_memory_operation", 1000, NULL, run_conditional, NULL, 0, 0, 0 },
+    { "scratch/recursive_leak/depth16", 1000, NULL,   run_recursive,    NULL, 16, 0, 0 },
+    { "circular_buffer",             200, NULL,        run_circular_buffer, NULL, 0, 0, 0 },
+};
+
+/* ---------------------------------------------------------------------- */
+/*  Замеры                                                                 */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    double mean, p50, p90, p99, min, max;
+    double allocs_per_op;
+    size_t sample_ops;             /* операций в одном замере */
+} Result;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t n, double p) {
+    size_t idx = (size_t)(p * (double)(n - 1) + 0.5);
+    return sorted[idx];
+}
+
+static double timer_overhead_ns;   /* пара вызовов now_ns подряд, медиана */
+
+static void calibrate_timer(void) {
+    double pairs[1001];
+    for (int i = 0; i < 1001; i++) {
+        double start = now_ns();
+        pairs[i] = now_ns() - start;
+    }
+    qsort(pairs, 1001, sizeof(double), cmp_double);
+    timer_overhead_ns = pairs[500];
+}
+
+static Result measure(const Bench *b, int warmup, int repeat, size_t sample_ops) {
+    size_t step = b->whole ? b->batch : sample_ops;
+    size_t per_repeat = (b->batch + step - 1) / step;
+    double *samples = malloc(per_repeat * (size_t)repeat * sizeof(double));
+    size_t n = 0, allocs = 0;
+    double total = 0;
+    Result r = {0};
+    if (!samples) return r;
+
+    for (int i = -warmup; i < repeat; i++) {
+        if (b->setup) b->setup(b);
+        size_t allocs_before = bench_allocs;
+        for (size_t begin = 0; begin < b->batch; begin += step) {
+            size_t end = begin + step < b->batch ? begin + step : b->batch;
+            double start = now_ns();
+            b->run(b, begin, end);
+            double elapsed = now_ns() - start - timer_overhead_ns;
+            if (elapsed < 0) elapsed = 0;
+            if (i >= 0) {
+                samples[n++] = elapsed / (double)(end - begin);
+                total += elapsed;
+            }
+        }
+        if (i >= 0) allocs += bench_allocs - allocs_before;
+        if (b->teardown) b->teardown(b);
+    }
+
+    r.mean = total / ((double)b->batch * repeat);
+    qsort(samples, n, sizeof(double), cmp_double);
+    r.p50 = percentile(samples, n, 0.50);
+    r.p90 = percentile(samples, n, 0.90);
+    r.p99 = percentile(samples, n, 0.99);
+    r.min = samples[0];
+    r.max = samples[n - 1];
+    r.sample_ops = step;
+    r.allocs_per_op = (double)allocs / ((double)b->batch * repeat);
+    free(samples);
+    return r;
+}
+
+/* Медиана теста из прошлого JSON-отчёта, или -1 */
+static double baseline_p50(const char *path, const char *name) {
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+    char line[1024], key[128];
+    double value = -1;
+    snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+    while (fgets(line, sizeof(line), file)) {
+        if (!strstr(line, key)) continue;
+        const char *p = strstr(line, "\"p50_ns\": ");
+        if (p) value = atof(p + 10);
+        break;
+    }
+    fclose(file);
+    return value;
+}
+
+static void pin_to_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        perror("sched_setaffinity");
+}
+
+static int prepare_files(void) {
+    snprintf(small_file, sizeof(small_file), "/tmp/microbench_small_%d.txt", (int)getpid());
+    snprintf(large_file, sizeof(large_file), "/tmp/microbench_large_%d.txt", (int)getpid());
+
+    FILE *small = fopen(small_file, "w");
+    FILE *large = fopen(large_file, "w");
+    if (!small || !large) {
+        perror("fopen");
+        if (small) fclose(small);
+        if (large) fclose(large);
+        return -1;
+    }
+    fprintf(small, "Short line\n");
+    /* первая строка длиннее 100 символов, дальше ~1 МБ данных */
+    for (int i = 0; i < 16384; i++)
+        fprintf(large, "%s", i % 64 == 63 ? "Long line of the large test file.........................\n"
+                                          : "Long line of the large test file.........................");
+    fclose(small);
+    fclose(large);
+    return 0;
+}
+
+static void show_usage(const char *prog) {
+    printf("Usage: %s [--filter <substr>] [--repeat <n>] [--warmup <n>] [--cpu <n>]\n"
+           "       %*s [--sample-ops <n>] [--baseline <json>] [--threshold <percent>]\n",
+           prog, (int)strlen(prog), "");
+}
+
+int main(int argc, char *argv[]) {
+    const char *filter = NULL, *baseline = NULL;
+    int repeat = 30, warmup = 3, cpu = 0, sample_ops = 1;
+    double threshold = 10.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--filter") == 0) filter = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--repeat") == 0) repeat = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--warmup") == 0) warmup = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--cpu") == 0) cpu = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--sample-ops") == 0) sample_ops = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--baseline") == 0) baseline = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--threshold") == 0) threshold = atof(argv[++i]);
+        else {
+            show_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (repeat < 1 || warmup < 0 || sample_ops < 1) {
+        show_usage(argv[0]);
+        return 2;
+    }
+
+    pin_to_cpu(cpu);
+    calibrate_timer();
+    if (prepare_files() != 0) return 2;
+    for (int i = 0; i < MAX_KEYS; i++)
+        sprintf(bench_keys[i], "temp_key_%d", i);
+    memset(bench_value, 'v', sizeof(bench_value));
+
+    int regressions = 0, first = 1;
+    printf("{\"cpu\": %d, \"repeat\": %d, \"warmup\": %d, \"timer_overhead_ns\": %.1f, \"benchmarks\": [\n",
+           cpu, repeat, warmup, timer_overhead_ns);
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        const Bench *b = &benches[i];
+        if (filter && !strstr(b->name, filter)) continue;
+
+        Result r = measure(b, warmup, repeat, (size_t)sample_ops);
+        printf("%s  {\"name\": \"%s\", \"batch\": %zu, \"sample_ops\": %zu, \"ns_per_op\": %.1f, \"p50_ns\": %.1f, "
+               "\"p90_ns\": %.1f, \"p99_ns\": %.1f, \"min_ns\": %.1f, \"max_ns\": %.1f, "
+               "\"allocs_per_op\": %.2f}",
+               first ? "" : ",\n", b->name, b->batch, r.sample_ops, r.mean, r.p50, r.p90, r.p99,
+               r.min, r.max, r.allocs_per_op);
+        first = 0;
+        fflush(stdout);
+
+        double old = baseline ? baseline_p50(baseline, b->name) : -1;
+        if (old > 0 && r.p50 > old * (1.0 + threshold / 100.0)) {
+            fprintf(stderr, "РЕГРЕССИЯ %s: p50 %.1f ns -> %.1f ns (+%.0f%%)\n",
+                    b->name, old, r.p50, (r.p50 / old - 1.0) * 100.0);
+            regressions++;
+        }
+    }
+    printf("\n]}\n");
+
+    remove(small_file);
+    remove(large_file);
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,217 @@
+/*  numa_bench.c
+ *  ─────────────────────────────────────────────────────────────────────
+ *  Сравнение одного общего Cache с разделами по NUMA-узлам (NumaCache)
+ *  под нагрузкой из нескольких закреплённых потоков.
+ *
+ *  * Поток t закрепляется за процессорами узла t % узлов, так что
+ *    потоки поровну делятся между сокетами.
+ *  * Каждый поток выполняет --ops операций над --keys ключами: доля
+ *    --read-pct процентов – get, остальное – add.  Последовательность
+ *    ключей у потока своя, но одинаковая для всех режимов.
+ *  * Режимы: global – один Cache, созданный главным потоком (как
+ *    initialize_global_cache); numa – по разделу на узел; numa+replicate
+ *    – то же с копированием читаемых записей в локальный раздел.
+ *    --cache-size – общая ёмкость во всех режимах: в numa она делится
+ *    между разделами, так что режимы сравниваются при равной памяти.
+ *    В global вытеснение освобождает данные (free_evicted = 1), как и
+ *    в разделах NumaCache, – режимы различаются только раскладкой.
+ *  * NumaCache: запись берёт блокировку только домашнего раздела ключа,
+ *    реплики удаляются по одному разделу; память разделов – из арен
+ *    своих узлов.
+ *  * Отчёт – JSON, по режиму на строку: пропускная способность, ns на
+ *    операцию и доля попаданий.
+ *
+ *  На одноузловой машине все режимы работают с одним разделом;
+ *  NUMA_FAKE_NODES=2 эмулирует два узла, чтобы проверить логику
+ *  разделов (память при этом не привязывается).
+ *
+ *  Компиляция:
+ *      gcc -O2 -g -o numa_bench numa_bench.c -pthread
+ *
+ *  Запуск:
+ *      ./numa_bench --threads 16 --ops 200000 --read-pct 90
+ *      NUMA_FAKE_NODES=2 ./numa_bench --threads 4
+ *  ----------------------------------------------------------------------- */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define main prog_2_main
+#include "prog_2_files_cache.c"
+#undef main
+
+#define MAX_KEYS 65536
+
+enum { MODE_GLOBAL, MODE_NUMA, MODE_NUMA_REPLICATE, MODE_COUNT };
+
+static const char *mode_names[MODE_COUNT] = { "global", "numa", "numa+replicate" };
+
+typedef struct {
+    int index;
+    int mode;
+    int ops, keys, read_pct, value_size;
+    uint64_t elapsed_ns;
+    long hits, reads;
+} Worker;
+
+static Cache *bench_cache;
+static NumaCache *bench_numa;
+static char bench_keys[MAX_KEYS][24];
+static pthread_barrier_t start_barrier;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    int nodes = numa_topo_nodes();
+    if (numa_topo_bind_thread(w->index % nodes) != 0)
+        fprintf(stderr, "поток %d: не удалось закрепить за узлом %d\n", w->index, w->index % nodes);
+
+    char value[4096], out[4096];
+    memset(value, 'v', sizeof(value));
+    uint64_t rng = 0x9e3779b97f4a7c15ULL * (uint64_t)(w->index + 1);
+
+    pthread_barrier_wait(&start_barrier);
+    uint64_t start = now_ns();
+    for (int i = 0; i < w->ops; i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        const char *key = bench_keys[rng % (uint64_t)w->keys];
+        int is_read = (int)((rng >> 32) % 100) < w->read_pct;
+        long got = -1;
+        switch (w->mode) {
+            case MODE_GLOBAL:
+                if (is_read) got = get_from_cache(bench_cache, key, out, sizeof(out));
+                else add_to_cache(bench_cache, key, value, (size_t)w->value_size);
+                break;
+            default:
+                if (is_read) got = get_from_numa_cache(bench_numa, key, out, sizeof(out));
+                else add_to_numa_cache(bench_numa, key, value, (size_t)w->value_size);
+                break;
+        }
+        if (is_read) {
+            w->reads++;
+            if (got >= 0) w->hits++;
+        }
+    }
+    w->elapsed_ns = now_ns() - start;
+    return NULL;
+}
+
+static int run_mode(int mode, int threads, int ops, int keys, int read_pct,
+                    int value_size, int cache_size) {
+    if (mode == MODE_GLOBAL) {
+        bench_cache = create_cache(cache_size);
+        if (bench_cache) bench_cache->free_evicted = 1;
+    } else bench_numa = create_numa_cache(cache_size, mode == MODE_NUMA_REPLICATE);
+    if (mode == MODE_GLOBAL ? !bench_cache : !bench_numa) {
+        fprintf(stderr, "Недостаточно памяти\n");
+        return -1;
+    }
+
+    /* прогрев: все ключи один раз, из главного потока */
+    char value[4096];
+    memset(value, 'v', sizeof(value));
+    for (int k = 0; k < keys; k++) {
+        if (mode == MODE_GLOBAL) add_to_cache(bench_cache, bench_keys[k], value, (size_t)value_size);
+        else add_to_numa_cache(bench_numa, bench_keys[k], value, (size_t)value_size);
+    }
+
+    Worker workers[threads];
+    pthread_t tids[threads];
+    pthread_barrier_init(&start_barrier, NULL, (unsigned)threads);
+    for (int t = 0; t < threads; t++) {
+        workers[t] = (Worker){ .index = t, .mode = mode, .ops = ops, .keys = keys,
+                               .read_pct = read_pct, .value_size = value_size };
+        if (pthread_create(&tids[t], NULL, worker_main, &workers[t]) != 0) {
+            perror("pthread_create");
+            return -1;
+        }
+    }
+    uint64_t slowest = 0;
+    long hits = 0, reads = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        if (workers[t].elapsed_ns > slowest) slowest = workers[t].elapsed_ns;
+        hits += workers[t].hits;
+        reads += workers[t].reads;
+    }
+    pthread_barrier_destroy(&start_barrier);
+
+    double total = (double)ops * threads;
+    printf("  {\"mode\": \"%s\", \"ops\": %.0f, \"elapsed_ms\": %.3f, \"throughput_ops_s\": %.0f, "
+           "\"ns_per_op_per_thread\": %.1f, \"hit_rate\": %.3f}",
+           mode_names[mode], total, slowest / 1e6, total / (slowest / 1e9),
+           (double)slowest / ops, reads ? (double)hits / reads : 0.0);
+
+    /* общий кэш не освобождается, как и global_cache в программе */
+    bench_cache = NULL;
+    destroy_numa_cache(bench_numa);
+    bench_numa = NULL;
+    return 0;
+}
+
+static void show_usage(const char *prog) {
+    printf("Usage: %s [--threads <n>] [--ops <n>] [--keys <n>] [--read-pct <0-100>]\n"
+           "       %*s [--value-size <bytes>] [--cache-size <n>] [--mode global|numa|numa+replicate]\n",
+           prog, (int)strlen(prog), "");
+}
+
+int main(int argc, char *argv[]) {
+    int threads = 0, ops = 200000, keys = 256, read_pct = 90, value_size = 64;
+    int cache_size = 256, only_mode = -1;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) threads = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--ops") == 0) ops = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--keys") == 0) keys = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--read-pct") == 0) read_pct = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--value-size") == 0) value_size = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--cache-size") == 0) cache_size = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--mode") == 0) {
+            const char *name = argv[++i];
+            for (int m = 0; m < MODE_COUNT; m++)
+                if (strcmp(name, mode_names[m]) == 0) only_mode = m;
+            if (only_mode < 0) {
+                show_usage(argv[0]);
+                return 2;
+            }
+        } else {
+            show_usage(argv[0]);
+            return 2;
+        }
+    }
+    int nodes = numa_topo_nodes();
+    if (threads <= 0) threads = 2 * nodes;
+    if (ops < 1 || keys < 1 || keys > MAX_KEYS || read_pct < 0 || read_pct > 100 ||
+        value_size < 1 || value_size > 4096 || cache_size < 1) {
+        show_usage(argv[0]);
+        return 2;
+    }
+
+    for (int k = 0; k < keys; k++)
+        snprintf(bench_keys[k], sizeof(bench_keys[k]), "numa_key_%d", k);
+
+    printf("{\"nodes\": %d, \"fake_nodes\": %s, \"threads\": %d, \"keys\": %d, \"read_pct\": %d, "
+           "\"value_size\": %d, \"cache_size\": %d, \"results\": [\n",
+           nodes, numa_topo_fake ? "true" : "false", threads, keys, read_pct, value_size, cache_size);
+    int first = 1;
+    for (int m = 0; m < MODE_COUNT; m++) {
+        if (only_mode >= 0 && m != only_mode) continue;
+        if (!first) printf(",\n");
+        first = 0;
+        if (run_mode(m, threads, ops, keys, read_pct, value_size, cache_size) != 0) return 1;
+    }
+    printf("\n]}\n");
+    return 0;
+}
@@ -0,0 +1,264 @@
+/*  numa_topology.h
+ *  ─────────────────────────────────────────────────────────────────────
+ *  Минимум NUMA без libnuma: число узлов, узел текущего потока,
+ *  процессоры узла, память на заданном узле.
+ *
+ *  * Топология читается из /sys/devices/system/node; если каталога
+ *    нет, машина считается одноузловой.
+ *  * Узел потока – процессор из sched_getcpu() (glibc читает его из
+ *    rseq или vDSO, без системного вызова) и таблица процессор → узел,
+ *    прочитанная из sysfs один раз.  Поток может переехать на другой
+ *    узел в любой момент, поэтому результат – подсказка для размещения,
+ *    а не гарантия.
+ *  * numa_topo_alloc() выделяет страницы через mmap и просит ядро
+ *    (mbind, MPOL_PREFERRED) размещать их на узле.  Если mbind
+ *    недоступен (одноузловая машина, контейнер без прав), память всё
+ *    равно выделена – просто по обычной политике first touch.
+ *  * NumaArena – блоки любого размера из памяти одного узла для
+ *    структур, которые там живут (записи и данные раздела кэша).
+ *    Освобождённый блок возвращается в арену своего узла, в каком бы
+ *    потоке его ни освобождали, – в отличие от malloc, чей tcache отдал
+ *    бы его следующему выделению этого потока на любом узле.
+ *  * NUMA_FAKE_NODES=<n> на одноузловой машине эмулирует n узлов:
+ *    потоки распределяются по ним по кругу (или numa_topo_bind_thread),
+ *    память не привязывается.  Это нужно, чтобы проверять логику
+ *    разделов на обычной машине.
+ *  ----------------------------------------------------------------------- */
+
+#ifndef NUMA_TOPOLOGY_H
+#define NUMA_TOPOLOGY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* <sched.h> объявляет её только при _GNU_SOURCE */
+int sched_getcpu(void);
+
+#define NUMA_TOPO_MAX_NODES 64
+#define NUMA_TOPO_MAX_CPUS  1024
+#define NUMA_TOPO_MPOL_PREFERRED 1
+
+static int numa_topo_node_count;         /* 0 – ещё не определено */
+static int numa_topo_fake;               /* узлы эмулируются */
+static unsigned numa_topo_fake_next;
+static __thread int numa_topo_thread_node = -1;   /* только для эмуляции */
+static unsigned char numa_topo_cpu_node[NUMA_TOPO_MAX_CPUS];   /* процессор → узел */
+
+/* Список вида "0-3,8,10-11" в флаги out[0..max); возвращает число
+ * элементов или -1 */
+static int numa_topo_parse_list(const char *path, unsigned char *out, int max) {
+    char buf[4096];
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+    if (!fgets(buf, sizeof(buf), file)) buf[0] = '\0';
+    fclose(file);
+
+    int count = 0;
+    char *p = buf;
+    while (*p >= '0' && *p <= '9') {
+        long lo = strtol(p, &p, 10), hi = lo;
+        if (*p == '-') hi = strtol(p + 1, &p, 10);
+        for (long i = lo; i <= hi && i < max; i++) {
+            if (!out[i]) count++;
+            out[i] = 1;
+        }
+        if (*p == ',') p++;
+    }
+    return count;
+}
+
+static int numa_topo_nodes(void) {
+    int n = __atomic_load_n(&numa_topo_node_count, __ATOMIC_ACQUIRE);
+    if (n) return n;
+
+    unsigned char online[NUMA_TOPO_MAX_NODES] = {0};
+    n = 1;
+    if (numa_topo_parse_list("/sys/devices/system/node/online", online, NUMA_TOPO_MAX_NODES) > 0) {
+        for (int i = 0; i < NUMA_TOPO_MAX_NODES; i++)
+            if (online[i]) n = i + 1;
+    }
+    /* таблица заполняется до публикации числа узлов */
+    for (int node = 0; node < n && n > 1; node++) {
+        unsigned char set[NUMA_TOPO_MAX_CPUS] = {0};
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        if (numa_topo_parse_list(path, set, NUMA_TOPO_MAX_CPUS) <= 0) continue;
+        for (int cpu = 0; cpu < NUMA_TOPO_MAX_CPUS; cpu++)
+            if (set[cpu]) numa_topo_cpu_node[cpu] = (unsigned char)node;
+    }
+    const char *fake = getenv("NUMA_FAKE_NODES");
+    if (n == 1 && fake && atoi(fake) > 1) {
+        n = atoi(fake) < NUMA_TOPO_MAX_NODES ? atoi(fake) : NUMA_TOPO_MAX_NODES;
+        numa_topo_fake = 1;
+    }
+    __atomic_store_n(&numa_topo_node_count, n, __ATOMIC_RELEASE);
+    return n;
+}
+
+static inline int numa_topo_current_node(void) {
+    int nodes = numa_topo_nodes();
+    if (nodes == 1) return 0;
+    if (numa_topo_fake) {
+        if (numa_topo_thread_node < 0)
+            numa_topo_thread_node = (int)(__atomic_fetch_add(&numa_topo_fake_next, 1, __ATOMIC_RELAXED) % (unsigned)nodes);
+        return numa_topo_thread_node;
+    }
+    int cpu = sched_getcpu();
+    if (cpu < 0 || cpu >= NUMA_TOPO_MAX_CPUS) return 0;
+    return numa_topo_cpu_node[cpu];
+}
+
+/* Номера процессоров узла в cpus[0..max); возвращает их число */
+static int numa_topo_node_cpus(int node, int *cpus, int max) {
+    unsigned char set[NUMA_TOPO_MAX_CPUS] = {0};
+    int nodes = numa_topo_nodes();
+    if (numa_topo_fake || nodes == 1) {
+        /* все процессоры машины на каждом эмулированном узле */
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long i = 0; i < online && i < NUMA_TOPO_MAX_CPUS; i++) set[i] = 1;
+    } else {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        if (numa_topo_parse_list(path, set, NUMA_TOPO_MAX_CPUS) < 0) return 0;
+    }
+    int count = 0;
+    for (int i = 0; i < NUMA_TOPO_MAX_CPUS && count < max; i++)
+        if (set[i]) cpus[count++] = i;
+    return count;
+}
+
+/* Закрепить поток за процессорами узла; 0 – успех */
+static inline int numa_topo_bind_thread(int node) {
+    int cpus[NUMA_TOPO_MAX_CPUS];
+    int n = numa_topo_node_cpus(node, cpus, NUMA_TOPO_MAX_CPUS);
+    if (numa_topo_fake) numa_topo_thread_node = node;
+    if (n == 0) return -1;
+
+    unsigned long mask[NUMA_TOPO_MAX_CPUS / (8 * sizeof(unsigned long))] = {0};
+    for (int i = 0; i < n; i++)
+        mask[cpus[i] / (8 * sizeof(unsigned long))] |= 1UL << (cpus[i] % (8 * sizeof(unsigned long)));
+    return syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) == 0 ? 0 : -1;
+}
+
+/* Память с предпочтительным размещением на узле, обнулённая */
+static void *numa_topo_alloc(size_t size, int node) {
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return NULL;
+    if (!numa_topo_fake && numa_topo_nodes() > 1) {
+        unsigned long mask[NUMA_TOPO_MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+        mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+        /* ошибка не фатальна: страницы лягут по first touch */
+        syscall(SYS_mbind, mem, size, NUMA_TOPO_MPOL_PREFERRED, mask, NUMA_TOPO_MAX_NODES + 1, 0);
+    }
+    return mem;
+}
+
+static void numa_topo_free(void *mem, size_t size) {
+    if (mem) munmap(mem, size);
+}
+
+/* ---------------------------------------------------------------------- */
+/*  Арена на узле                                                          */
+/* ---------------------------------------------------------------------- */
+
+/* Память берётся у numa_topo_alloc кусками по NUMA_ARENA_CHUNK; блоки –
+ * степени двойки от 32 байт до 64 КиБ вместе с 16-байтным заголовком,
+ * освобождённые лежат в списке своего размера.  Блок больше – отдельное
+ * отображение.  Арена не потокобезопасна: её защищает блокировка
+ * владельца (раздела кэша). */
+#define NUMA_ARENA_CHUNK     (1024 * 1024)
+#define NUMA_ARENA_MIN_SHIFT 5
+#define NUMA_ARENA_MAX_SHIFT 16
+#define NUMA_ARENA_CLASSES   (NUMA_ARENA_MAX_SHIFT - NUMA_ARENA_MIN_SHIFT + 1)
+
+typedef struct numa_arena_chunk {
+    struct numa_arena_chunk *next;
+    size_t size;
+} NumaArenaChunk;
+
+typedef struct {
+    size_t size;                 /* размер блока с заголовком */
+    size_t large;                /* 1 – отдельное отображение */
+} NumaArenaHeader;
+
+typedef struct {
+    int node;
+    NumaArenaChunk *chunks;
+    char *cursor;                /* свободный хвост последнего куска */
+    size_t left;
+    void *free_lists[NUMA_ARENA_CLASSES];
+} NumaArena;
+
+static void numa_arena_init(NumaArena *arena, int node) {
+    memset(arena, 0, sizeof(*arena));
+    arena->node = node;
+}
+
+static void *numa_arena_alloc(NumaArena *arena, size_t size) {
+    size_t total = size + sizeof(NumaArenaHeader);
+    NumaArenaHeader *hdr;
+    if (total > ((size_t)1 << NUMA_ARENA_MAX_SHIFT)) {
+        hdr = numa_topo_alloc(total, arena->node);
+        if (!hdr) return NULL;
+        hdr->size = total;
+        hdr->large = 1;
+        return hdr + 1;
+    }
+
+    int shift = NUMA_ARENA_MIN_SHIFT;
+    while (((size_t)1 << shift) < total) shift++;
+    size_t block = (size_t)1 << shift;
+    void **list = &arena->free_lists[shift - NUMA_ARENA_MIN_SHIFT];
+    if (*list) {
+        hdr = *list;
+        memcpy(list, hdr + 1, sizeof(void *));   /* ссылка – в теле блока */
+    } else {
+        if (arena->left < block) {
+            /* остаток текущего куска (меньше блока) пропадает */
+            NumaArenaChunk *chunk = numa_topo_alloc(NUMA_ARENA_CHUNK, arena->node);
+            if (!chunk) return NULL;
+            chunk->next = arena->chunks;
+            chunk->size = NUMA_ARENA_CHUNK;
+            arena->chunks = chunk;
+            /* заголовок куска – 16 байт, тела блоков выровнены на 16 */
+            arena->cursor = (char *)chunk + sizeof(NumaArenaChunk);
+            arena->left = NUMA_ARENA_CHUNK - sizeof(NumaArenaChunk);
+        }
+        hdr = (NumaArenaHeader *)arena->cursor;
+        arena->cursor += block;
+        arena->left -= block;
+    }
+    hdr->size = block;
+    hdr->large = 0;
+    return hdr + 1;
+}
+
+static void numa_arena_free(NumaArena *arena, void *ptr) {
+    if (!ptr) return;
+    NumaArenaHeader *hdr = (NumaArenaHeader *)ptr - 1;
+    if (hdr->large) {
+        numa_topo_free(hdr, hdr->size);
+        return;
+    }
+    void **list = &arena->free_lists[__builtin_ctzl(hdr->size) - NUMA_ARENA_MIN_SHIFT];
+    memcpy(ptr, list, sizeof(void *));
+    *list = hdr;
+}
+
+/* Отдаёт системе все куски; большие блоки владелец освобождает сам */
+static void numa_arena_destroy(NumaArena *arena) {
+    while (arena->chunks) {
+        NumaArenaChunk *next = arena->chunks->next;
+        numa_topo_free(arena->chunks, arena->chunks->size);
+        arena->chunks = next;
+    }
+    memset(arena->free_lists, 0, sizeof(arena->free_lists));
+    arena->cursor = NULL;
+    arena->left = 0;
+}
+
+#endif /* NUMA_TOPOLOGY_H */
@@ -0,0 +1,90 @@
+/*  preload_hooks.h
+ *  ─────────────────────────────────────────────────────────────────────
+ *  Общие части LD_PRELOAD-библиотек (leak_tracker.c, heap_sampler.c):
+ *  доступ к настоящему аллокатору glibc, выделение служебной памяти
+ *  мимо кучи и раскрутка стека по frame pointer'ам.
+ *
+ *  Файл подключается ровно в одну единицу трансляции каждой библиотеки,
+ *  поэтому все функции – static.
+ *  ----------------------------------------------------------------------- */
+
+#ifndef PRELOAD_HOOKS_H
+#define PRELOAD_HOOKS_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Реальные функции glibc – не требуют dlsym, а значит и calloc при старте */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void  __libc_free(void *ptr);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void *__libc_stack_end;
+
+/* initial-exec: обращение к TLS не должно уходить в __tls_get_addr/malloc */
+#define HOOK_TLS __thread __attribute__((tls_model("initial-exec")))
+
+static HOOK_TLS uintptr_t stack_hi;
+
+/* Служебная память берётся через mmap, чтобы не попадать в собственные хуки */
+static void *map_zeroed(size_t size) {
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/* ---------------------------------------------------------------------- */
+/*  Раскрутка стека по frame pointer'ам                                    */
+/* ---------------------------------------------------------------------- */
+
+static uintptr_t current_stack_hi(void) {
+    if (stack_hi) return stack_hi;
+
+    if (gettid() == getpid()) {
+        stack_hi = (uintptr_t)__libc_stack_end;
+    } else {
+        pthread_attr_t attr;
+        void *addr;
+        size_t size;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+            if (pthread_attr_getstack(&attr, &addr, &size) == 0)
+                stack_hi = (uintptr_t)addr + size;
+            pthread_attr_destroy(&attr);
+        }
+    }
+    return stack_hi;
+}
+
+/* Цепочка: fp[0] – сохранённый fp вызывающего, fp[1] – адрес возврата.
+ * Обрываем её, как только fp перестаёт расти или выходит за стек.
+ * always_inline: первым кадром должен быть вызывающий перехватчик. */
+static inline __attribute__((always_inline))
+int unwind(void **frames, int max) {
+    uintptr_t hi = current_stack_hi();
+    uintptr_t *fp = __builtin_frame_address(0);
+    int n = 0;
+
+    while (n < max && hi && (uintptr_t)fp < hi && ((uintptr_t)fp & 7) == 0) {
+        void *ret = (void *)fp[1];
+        uintptr_t *next = (uintptr_t *)fp[0];
+        if (!ret) break;
+        frames[n++] = ret;
+        if (next <= fp) break;
+        fp = next;
+    }
+    return n;
+}
+
+#endif /* PRELOAD_HOOKS_H */
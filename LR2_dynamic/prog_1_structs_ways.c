@@ -2,11 +2,16 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "scratch_arena.h"
+#include "string_intern.h"
+#include "workload_trace.h"
+
 typedef struct node {
     int id;
-    char *data;
+    InternId data;      // строка в таблице string_intern.h
     struct node *next;
     struct node *prev;
+    char data_copy[];   // своя копия, если таблица строк отказала (data == 0)
 } Node;
 
 typedef struct list {
@@ -26,16 +31,19 @@ List* create_list() {
 }
 
 void add_node(List *list, int id, const char *data) {
-    Node *new_node = malloc(sizeof(Node));
+    trace_record(TRACE_OP_LIST_ADD, id, 0, data);
+    if (!data) return;
+
+    // Таблица строк может отказать (заполнена или нет памяти) – тогда
+    // узел хранит копию строки сам, и узел освобождается одним free
+    InternId interned = intern(data);
+    size_t copy_size = interned ? 0 : strlen(data) + 1;
+    Node *new_node = malloc(sizeof(Node) + copy_size);
     if (!new_node) return;
     
     new_node->id = id;
-    new_node->data = malloc(strlen(data) + 1);
-    if (!new_node->data) {
-        free(new_node);  // Корректно, но есть скрытая утечка при определенных условиях
-        return;
-    }
-    strcpy(new_node->data, data);
+    new_node->data = interned;
+    if (!interned) memcpy(new_node->data_copy, data, copy_size);
     new_node->next = NULL;
     new_node->prev = list->tail;
     
@@ -48,8 +56,13 @@ void add_node(List *list, int id, const char *data) {
     list->size++;
 }
 
+const char *node_data(const Node *node) {
+    return node->data ? intern_str(node->data) : node->data_copy;
+}
+
 // Уязвимость: частичное удаление в циклическом списке
 int remove_node_by_id(List *list, int id) {
+    trace_record(TRACE_OP_LIST_REMOVE, id, 0, NULL);
     if (!list || !list->head) return -1;
     
     Node *current = list->head;
@@ -67,8 +80,7 @@ int remove_node_by_id(List *list, int id) {
                 list->tail = current->prev;
             }
             
-            // УТЕЧКА: забыли освободить current->data
-            free(current);  // Освободили узел, но не данные
+            free(current);  // Данные интернированы, их владелец – таблица строк
             list->size--;
             return 0;
         }
@@ -84,46 +96,42 @@ void destroy_list_partial(List *list) {
     Node *current = list->head;
     while (current) {
         Node *next = current->next;
-        free(current->data);  // Освободили данные
         free(current);        // Освободили узел
         current = next;
     }
     // УТЕЧКА: забыли освободить саму структуру List
 }
 
-// Сложная условная утечка
+// Сложная условная логика: буферы берутся из scratch-арены и
+// возвращаются в неё при выходе на любом пути
 void conditional_memory_operation(int condition1, int condition2) {
-    char *buffer1 = malloc(100);
-    char *buffer2 = malloc(200);
+    SCRATCH_SCOPE(scope);
+    char *buffer1 = scratch_alloc(100);
+    char *buffer2 = scratch_alloc(200);
+    if (!buffer1 || !buffer2) return;
     
     if (condition1) {
         sprintf(buffer1, "Condition 1 executed");
         if (condition2) {
             sprintf(buffer2, "Both conditions true");
-            // В этом пути все освобождается
-            free(buffer1);
-            free(buffer2);
             return;
         }
-        // УТЕЧКА: при condition1=true и condition2=false buffer2 не освобождается
-        free(buffer1);
     } else {
         sprintf(buffer2, "Condition 1 false");
-        // УТЕЧКА: при condition1=false buffer1 не освобождается
-        free(buffer2);
     }
 }
 
-// Утечка в рекурсивной функции
+// Рекурсия: у каждого уровня своя область арены, буфер уровня
+// освобождается при возврате из него
 void recursive_leak(int depth, int max_depth) {
-    char *local_buffer = malloc(50);
+    SCRATCH_SCOPE(scope);
+    char *local_buffer = scratch_alloc(50);
+    if (!local_buffer) return;
     sprintf(local_buffer, "Depth: %d", depth);
     
     if (depth < max_depth) {
         recursive_leak(depth + 1, max_depth);
     }
-    
-    // УТЕЧКА: забыли free(local_buffer) - теряем память на каждом уровне рекурсии
 }
 
 int main(int argc, char *argv[]) {
@@ -144,7 +152,7 @@ int main(int argc, char *argv[]) {
     
     switch (operation) {
         case 1:
-            // Удаляем с утечкой данных
+            // Удаляем узел (строка данных принадлежит таблице интернирования)
             remove_node_by_id(my_list, value);
             break;
         case 2:
@@ -153,11 +161,11 @@ int main(int argc, char *argv[]) {
             my_list = NULL;  // Теперь невозможно освободить структуру List
             break;
         case 3:
-            // Сложная условная утечка
+            // Условные ветки: буферы возвращаются в scratch-арену
             conditional_memory_operation(value > 5, value < 10);
             break;
         case 4:
-            // Рекурсивная утечка
+            // Рекурсия: буфер каждого уровня освобождается при возврате
             recursive_leak(0, value);
             break;
     }
@@ -1,24 +1,37 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 #include <pthread.h>
 
+#include "scratch_arena.h"
+#include "numa_topology.h"
+#include "string_intern.h"
+#include "workload_trace.h"
+
 #define CACHE_SIZE 5
 
 typedef struct cache_entry {
-    char *key;
+    InternId key;       // строка в таблице string_intern.h
     void *data;
     size_t size;
     struct cache_entry *next;
     struct cache_entry *prev;
+    char key_copy[];    // своя копия ключа, только при key == INTERN_NONE
 } CacheEntry;
 
+typedef struct cache_reclaimer CacheReclaimer;
+
 typedef struct {
     CacheEntry *head;
     CacheEntry *tail;
     int count;
     int max_size;
     pthread_mutex_t lock;
+    CacheReclaimer *reclaimer;   // NULL – освобождение синхронно, под lock
+    int free_evicted;            // 1 – вытеснение освобождает и данные
 } Cache;
 
 // Глобальный кэш - утечка при завершении программы
@@ -33,55 +46,252 @@ Cache* create_cache(int max_size) {
     cache->count = 0;
     cache->max_size = max_size;
     pthread_mutex_init(&cache->lock, NULL);
+    cache->reclaimer = NULL;
+    cache->free_evicted = 0;
     return cache;
 }
 
-// Уязвимость: утечка при ошибке в середине функции
-void add_to_cache(Cache *cache, const char *key, const void *data, size_t size) {
-    if (!cache || !key || !data) return;
+// ---------------------------------------------------------------------
+// Отложенное освобождение и фоновое вытеснение
+//
+// Без фонового потока (cache->reclaimer == NULL) всё работает как
+// раньше: вытеснение и free – прямо под cache->lock.  После
+// cache_start_reclaimer:
+//
+// * вытесненные записи и заменённые данные только отцепляются под
+//   блокировкой и кладутся в стек без блокировок (CAS на вершине); free
+//   для них вызывает фоновый поток, забирая весь стек одной атомарной
+//   заменой раз в RECLAIM_INTERVAL_NS;
+// * если задан high_watermark, фоновый поток заранее вытесняет хвост,
+//   пока записей больше этой отметки, – пачками по RECLAIM_BATCH, чтобы
+//   не держать блокировку долго.  Пока вставки не обгоняют поток,
+//   add_to_cache до вытеснения не доходит вовсе.  Фактическая ёмкость
+//   кэша при этом – high_watermark (с кратковременными всплесками до
+//   max_size).
+//
+// Ссылка на следующий элемент стека пишется в первое слово самого
+// освобождаемого объекта, поэтому стеку не нужна своя память.  Младший
+// бит ссылки отличает запись (освободить и data) от блока данных.
+//
+// Сравнивать фоновый поток надо с синхронным режимом при free_evicted = 1:
+// иначе синхронный вариант платит ещё и за рост кучи из-за утечки.
+// ---------------------------------------------------------------------
+
+#define RECLAIM_INTERVAL_NS 1000000     // 1 мс
+#define RECLAIM_BATCH       32
+#define RECLAIM_ENTRY_TAG   ((uintptr_t)1)
+
+_Static_assert(offsetof(CacheEntry, data) >= sizeof(void *),
+               "ссылка стека не должна затирать CacheEntry.data");
+
+struct cache_reclaimer {
+    Cache *cache;
+    void *retired;                // вершина стека, с тегом
+    int high_watermark;           // 0 – без фонового вытеснения
+    int stop;
+    pthread_t thread;
+    pthread_mutex_t wake_lock;
+    pthread_cond_t wake;
+};
+
+// Вызывается под cache->lock.  Отцепляет хвост списка
+static CacheEntry *pop_tail_locked(Cache *cache) {
+    CacheEntry *to_remove = cache->tail;
+    if (!to_remove) return NULL;
+    cache->tail = to_remove->prev;
+    
+    if (cache->tail) {
+        cache->tail->next = NULL;
+    } else {
+        cache->head = NULL;
+    }
+    cache->count--;
+    return to_remove;
+}
+
+static void reclaim_push(CacheReclaimer *reclaimer, void *object, uintptr_t tag) {
+    void *head = __atomic_load_n(&reclaimer->retired, __ATOMIC_RELAXED);
+    do {
+        memcpy(object, &head, sizeof(head));
+    } while (!__atomic_compare_exchange_n(&reclaimer->retired, &head,
+                                          (void *)((uintptr_t)object | tag), 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// Вызывается под cache->lock.  Запись уже отцеплена от списка
+static void retire_entry_locked(Cache *cache, CacheEntry *entry) {
+    if (cache->reclaimer) {
+        reclaim_push(cache->reclaimer, entry, RECLAIM_ENTRY_TAG);
+    } else {
+        free(entry->data);
+        free(entry);
+    }
+}
+
+// Вызывается под cache->lock.  Блок короче указателя ссылку не вместит –
+// он освобождается сразу
+static void retire_data_locked(Cache *cache, void *data, size_t size) {
+    if (cache->reclaimer && data && size >= sizeof(void *)) {
+        reclaim_push(cache->reclaimer, data, 0);
+    } else {
+        free(data);
+    }
+}
+
+static void reclaim_drain(CacheReclaimer *reclaimer) {
+    void *item = __atomic_exchange_n(&reclaimer->retired, NULL, __ATOMIC_ACQUIRE);
+    while (item) {
+        void *object = (void *)((uintptr_t)item & ~RECLAIM_ENTRY_TAG);
+        int is_entry = ((uintptr_t)item & RECLAIM_ENTRY_TAG) != 0;
+        memcpy(&item, object, sizeof(item));
+        if (is_entry) free(((CacheEntry *)object)->data);
+        free(object);
+    }
+}
+
+static void reclaim_preevict(CacheReclaimer *reclaimer) {
+    Cache *cache = reclaimer->cache;
+    int more = 1;
+    while (more) {
+        CacheEntry *batch = NULL;
+        pthread_mutex_lock(&cache->lock);
+        for (int i = 0; i < RECLAIM_BATCH && cache->count > reclaimer->high_watermark; i++) {
+            CacheEntry *entry = pop_tail_locked(cache);
+            if (!entry) break;
+            entry->next = batch;
+            batch = entry;
+        }
+        more = cache->count > reclaimer->high_watermark;
+        pthread_mutex_unlock(&cache->lock);
+        
+        while (batch) {
+            CacheEntry *next = batch->next;
+            free(batch->data);
+            free(batch);
+            batch = next;
+        }
+    }
+}
+
+static void *reclaim_thread(void *arg) {
+    CacheReclaimer *reclaimer = arg;
+    
+    pthread_mutex_lock(&reclaimer->wake_lock);
+    while (!reclaimer->stop) {
+        pthread_mutex_unlock(&reclaimer->wake_lock);
+        if (reclaimer->high_watermark > 0) reclaim_preevict(reclaimer);
+        reclaim_drain(reclaimer);
+        
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_nsec += RECLAIM_INTERVAL_NS;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_mutex_lock(&reclaimer->wake_lock);
+        if (!reclaimer->stop) {
+            pthread_cond_timedwait(&reclaimer->wake, &reclaimer->wake_lock, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&reclaimer->wake_lock);
+    return NULL;
+}
+
+// Запускает фоновый поток освобождения.  high_watermark – отметка для
+// фонового вытеснения (0 – только отложенный free).  0 – успех
+int cache_start_reclaimer(Cache *cache, int high_watermark) {
+    if (!cache || cache->reclaimer || high_watermark < 0) return -1;
+    
+    CacheReclaimer *reclaimer = calloc(1, sizeof(CacheReclaimer));
+    if (!reclaimer) return -1;
+    reclaimer->cache = cache;
+    reclaimer->high_watermark = high_watermark;
+    pthread_mutex_init(&reclaimer->wake_lock, NULL);
+    
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&reclaimer->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    
+    if (pthread_create(&reclaimer->thread, NULL, reclaim_thread, reclaimer) != 0) {
+        pthread_cond_destroy(&reclaimer->wake);
+        pthread_mutex_destroy(&reclaimer->wake_lock);
+        free(reclaimer);
+        return -1;
+    }
+    
+    pthread_mutex_lock(&cache->lock);
+    cache->reclaimer = reclaimer;
+    pthread_mutex_unlock(&cache->lock);
+    return 0;
+}
+
+// Останавливает фоновый поток и освобождает всё, что он не успел
+void cache_stop_reclaimer(Cache *cache) {
+    if (!cache) return;
     
     pthread_mutex_lock(&cache->lock);
+    CacheReclaimer *reclaimer = cache->reclaimer;
+    cache->reclaimer = NULL;
+    pthread_mutex_unlock(&cache->lock);
+    if (!reclaimer) return;
+    
+    pthread_mutex_lock(&reclaimer->wake_lock);
+    reclaimer->stop = 1;
+    pthread_cond_signal(&reclaimer->wake);
+    pthread_mutex_unlock(&reclaimer->wake_lock);
+    pthread_join(reclaimer->thread, NULL);
     
+    reclaim_drain(reclaimer);
+    pthread_cond_destroy(&reclaimer->wake);
+    pthread_mutex_destroy(&reclaimer->wake_lock);
+    free(reclaimer);
+}
+
+// Ключ записи – номер в таблице строк.  Если таблица отказала
+// (заполнена или нет памяти), id == INTERN_NONE, и запись хранит копию
+// строки в key_copy; такие ключи сравниваются по тексту.  Два номера
+// сравниваются как числа – одна строка всегда получает один номер
+static int entry_has_key(const CacheEntry *entry, InternId id, const char *key) {
+    if (id && entry->key) return entry->key == id;
+    return strcmp(entry->key ? intern_str(entry->key) : entry->key_copy, key) == 0;
+}
+
+// Вызывается под cache->lock.  Уязвимость: утечка при вытеснении
+static void add_to_cache_locked(Cache *cache, InternId id, const char *key,
+                                const void *data, size_t size) {
     // Проверяем, существует ли уже ключ
     CacheEntry *current = cache->head;
     while (current) {
-        if (strcmp(current->key, key) == 0) {
+        if (entry_has_key(current, id, key)) {
             // Обновляем существующую запись
-            free(current->data);  // Освобождаем старые данные
+            retire_data_locked(cache, current->data, current->size);  // Старые данные
             
             current->data = malloc(size);
             if (!current->data) {
-                pthread_mutex_unlock(&cache->lock);
-                return;  // УТЕЧКА: current->key не освобожден при ошибке
+                current->size = 0;  // Запись остаётся в списке пустой
+                return;
             }
             memcpy(current->data, data, size);
             current->size = size;
-            pthread_mutex_unlock(&cache->lock);
             return;
         }
         current = current->next;
     }
     
     // Создаем новую запись
-    CacheEntry *new_entry = malloc(sizeof(CacheEntry));
-    if (!new_entry) {
-        pthread_mutex_unlock(&cache->lock);
-        return;
-    }
+    size_t key_size = id ? 0 : strlen(key) + 1;
+    CacheEntry *new_entry = malloc(sizeof(CacheEntry) + key_size);
+    if (!new_entry) return;
     
-    new_entry->key = malloc(strlen(key) + 1);
-    if (!new_entry->key) {
-        free(new_entry);  // Корректно
-        pthread_mutex_unlock(&cache->lock);
-        return;
-    }
-    strcpy(new_entry->key, key);
+    new_entry->key = id;
+    if (!id) memcpy(new_entry->key_copy, key, key_size);
     
     new_entry->data = malloc(size);
     if (!new_entry->data) {
-        // УТЕЧКА: new_entry->key не освобожден
         free(new_entry);
-        pthread_mutex_unlock(&cache->lock);
         return;
     }
     memcpy(new_entry->data, data, size);
@@ -102,34 +312,394 @@ void add_to_cache(Cache *cache, const char *key, const void *data, size_t size)
     
     // Удаляем старые записи если превышен лимит
     while (cache->count > cache->max_size && cache->tail) {
-        CacheEntry *to_remove = cache->tail;
-        cache->tail = to_remove->prev;
-        
-        if (cache->tail) {
-            cache->tail->next = NULL;
-        } else {
-            cache->head = NULL;
+        CacheEntry *to_remove = pop_tail_locked(cache);
+        if (cache->reclaimer) {
+            retire_entry_locked(cache, to_remove);  // free – в фоновом потоке
+            continue;
+        }
+        if (cache->free_evicted) {
+            free(to_remove->data);  // синхронная база для reclaimer
+            free(to_remove);
+            continue;
         }
         
-        // УТЕЧКА: забыли освободить to_remove->key и to_remove->data
+        // УТЕЧКА: забыли освободить to_remove->data
         free(to_remove);  // Только структура, данные теряются
-        cache->count--;
     }
+}
+
+void add_to_cache(Cache *cache, const char *key, const void *data, size_t size) {
+    if (!cache || !key || !data) return;
+    trace_record(TRACE_OP_CACHE_PUT, 0, size, key);
+    
+    // Ключ интернируется до захвата блокировки кэша: дальше он –
+    // просто номер, и поиск сравнивает целые числа.  0 – таблица строк
+    // отказала, запись хранит свою копию ключа
+    InternId id = intern(key);
+    
+    pthread_mutex_lock(&cache->lock);
+    add_to_cache_locked(cache, id, key, data, size);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Вызывается под cache->lock.  Найденная запись переносится в голову
+// списка (LRU); NULL, если ключа нет
+static CacheEntry *lookup_in_cache_locked(Cache *cache, InternId id, const char *key) {
+    CacheEntry *current = cache->head;
+    while (current && !entry_has_key(current, id, key)) {
+        current = current->next;
+    }
+    if (!current) return NULL;
     
+    if (current != cache->head) {
+        current->prev->next = current->next;
+        if (current->next) {
+            current->next->prev = current->prev;
+        } else {
+            cache->tail = current->prev;
+        }
+        current->prev = NULL;
+        current->next = cache->head;
+        cache->head->prev = current;
+        cache->head = current;
+    }
+    return current;
+}
+
+// Поиск по ключу: найденная запись переносится в голову списка (LRU).
+// Данные копируются в out (не больше out_size байт) под блокировкой,
+// потому что параллельный add_to_cache может заменить их.
+// Возвращает полный размер значения или -1, если ключа нет.
+long get_from_cache(Cache *cache, const char *key, void *out, size_t out_size) {
+    if (!cache || !key) return -1;
+    trace_record(TRACE_OP_CACHE_GET, 0, 0, key);
+    
+    // Строки нет в таблице – её нет и в кэше, если только таблица не
+    // отказывала (тогда ключ мог сохраниться копией); таблица не растёт
+    InternId id = intern_find(key);
+    if (!id && !intern_refused()) return -1;
+    
+    pthread_mutex_lock(&cache->lock);
+    
+    CacheEntry *current = lookup_in_cache_locked(cache, id, key);
+    if (!current) {
+        pthread_mutex_unlock(&cache->lock);
+        return -1;
+    }
+    
+    if (out) {
+        memcpy(out, current->data, current->size < out_size ? current->size : out_size);
+    }
+    long size = (long)current->size;
     pthread_mutex_unlock(&cache->lock);
+    return size;
 }
 
-// Утечка при обработке ошибок в файловых операциях
+// ---------------------------------------------------------------------
+// NUMA: по разделу на каждый узел
+//
+// * У каждого ключа есть домашний раздел – hash % nodes, hash тот же,
+//   что в таблице строк.  Запись идёт только в домашний раздел и берёт
+//   только его блокировку, так что записи разных ключей на разных
+//   узлах не мешают друг другу.
+// * Раздел, его записи и данные лежат в памяти его узла: всё выделяется
+//   из арены раздела (NumaArena из numa_topology.h, страницы с mbind на
+//   узел) и туда же возвращается, в каком бы потоке ни освобождалось.
+// * Чтение смотрит сначала в раздел своего узла, при промахе – в
+//   домашний раздел ключа.  С replicate найденное в чужом домашнем
+//   разделе копируется в свой раздел (реплика): часто читаемые и редко
+//   меняемые записи оказываются на каждом узле.
+// * Домашняя запись помнит маску узлов с репликами.  Запись значения
+//   забирает маску и уже после своей блокировки удаляет реплики по
+//   одному разделу за раз – только на этих узлах.  Если ключа в
+//   домашнем разделе не было (новый или вытесненный), маски нет, и
+//   реплики удаляются во всех разделах: вытеснение домашней записи
+//   реплик не трогает, они остаются верными копиями до следующей записи.
+// * Реплика вставляется, только если в своём разделе с момента промаха
+//   не удалялись реплики (счётчик invalidations) – иначе она могла бы
+//   вернуть значение старее уже завершённой записи.
+// * Две блокировки разделов никогда не берутся одновременно.
+// * На одноузловой машине раздел один, и всё сводится к обычному LRU.
+// ---------------------------------------------------------------------
+
+typedef struct numa_entry {
+    InternId key;               // 0 – ключ в key_copy, как у CacheEntry
+    void *data;                 // из арены раздела
+    size_t size;
+    uint64_t replicas;          // домашняя запись: узлы с репликами
+    struct numa_entry *next;
+    struct numa_entry *prev;
+    char key_copy[];
+} NumaEntry;
+
+_Static_assert(NUMA_TOPO_MAX_NODES <= 64, "маска реплик – uint64_t");
+
+typedef struct {
+    pthread_mutex_t lock;
+    NumaEntry *head;
+    NumaEntry *tail;
+    int count;
+    int max_size;
+    unsigned long invalidations;   // удалений реплик из этого раздела
+    NumaArena arena;
+} NumaShard;
+
+typedef struct {
+    int nodes;
+    int replicate;
+    NumaShard *shards[NUMA_TOPO_MAX_NODES];
+} NumaCache;
+
+NumaCache *global_numa_cache = NULL;
+
+static int numa_entry_has_key(const NumaEntry *entry, InternId id, const char *key) {
+    if (id && entry->key) return entry->key == id;
+    return strcmp(entry->key ? intern_str(entry->key) : entry->key_copy, key) == 0;
+}
+
+static int numa_home(const NumaCache *numa, InternId id, const char *key) {
+    uint32_t hash = id ? intern_hash(id) : intern_hash_bytes(key, strlen(key));
+    return (int)(hash % (uint32_t)numa->nodes);
+}
+
+// Функции numa_shard_*_locked вызываются под shard->lock
+
+static NumaEntry *numa_shard_find_locked(NumaShard *shard, InternId id, const char *key) {
+    NumaEntry *current = shard->head;
+    while (current && !numa_entry_has_key(current, id, key)) {
+        current = current->next;
+    }
+    return current;
+}
+
+static void numa_shard_unlink_locked(NumaShard *shard, NumaEntry *entry) {
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        shard->head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        shard->tail = entry->prev;
+    }
+    shard->count--;
+}
+
+static void numa_shard_push_head_locked(NumaShard *shard, NumaEntry *entry) {
+    entry->prev = NULL;
+    entry->next = shard->head;
+    if (shard->head) {
+        shard->head->prev = entry;
+    }
+    shard->head = entry;
+    if (!shard->tail) {
+        shard->tail = entry;
+    }
+    shard->count++;
+}
+
+static void numa_shard_free_locked(NumaShard *shard, NumaEntry *entry) {
+    numa_arena_free(&shard->arena, entry->data);
+    numa_arena_free(&shard->arena, entry);
+}
+
+// Найденная запись переносится в голову списка (LRU)
+static NumaEntry *numa_shard_lookup_locked(NumaShard *shard, InternId id, const char *key) {
+    NumaEntry *entry = numa_shard_find_locked(shard, id, key);
+    if (entry && entry != shard->head) {
+        numa_shard_unlink_locked(shard, entry);
+        numa_shard_push_head_locked(shard, entry);
+    }
+    return entry;
+}
+
+// Вставка или обновление, как add_to_cache_locked, но вытесненные записи
+// освобождаются целиком.  Возвращает 1, если ключ уже был; его маска
+// реплик снимается и отдаётся в *replicas (если он не NULL)
+static int numa_shard_put_locked(NumaShard *shard, InternId id, const char *key,
+                                 const void *data, size_t size, uint64_t *replicas) {
+    NumaEntry *entry = numa_shard_find_locked(shard, id, key);
+    void *copy = numa_arena_alloc(&shard->arena, size);
+    if (copy) memcpy(copy, data, size);
+    
+    if (entry) {
+        if (replicas) *replicas = entry->replicas;
+        entry->replicas = 0;
+        numa_arena_free(&shard->arena, entry->data);
+        entry->data = copy;
+        entry->size = copy ? size : 0;  // без памяти запись остаётся пустой
+        return 1;
+    }
+    if (!copy) return 0;
+    
+    size_t key_size = id ? 0 : strlen(key) + 1;
+    entry = numa_arena_alloc(&shard->arena, sizeof(NumaEntry) + key_size);
+    if (!entry) {
+        numa_arena_free(&shard->arena, copy);
+        return 0;
+    }
+    entry->key = id;
+    if (!id) memcpy(entry->key_copy, key, key_size);
+    entry->data = copy;
+    entry->size = size;
+    entry->replicas = 0;
+    numa_shard_push_head_locked(shard, entry);
+    
+    while (shard->count > shard->max_size && shard->tail) {
+        NumaEntry *to_remove = shard->tail;
+        numa_shard_unlink_locked(shard, to_remove);
+        numa_shard_free_locked(shard, to_remove);
+    }
+    return 0;
+}
+
+// Удаляет реплику ключа из раздела; счётчик растёт, даже если её нет, –
+// чтобы чтение, которое сейчас копирует старое значение, не вставило его
+static void numa_shard_invalidate(NumaShard *shard, InternId id, const char *key) {
+    pthread_mutex_lock(&shard->lock);
+    NumaEntry *entry = numa_shard_find_locked(shard, id, key);
+    if (entry) {
+        numa_shard_unlink_locked(shard, entry);
+        numa_shard_free_locked(shard, entry);
+    }
+    shard->invalidations++;
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// max_size – общая ёмкость, как у create_cache: она делится между
+// разделами поровну (остаток – первым), но не меньше одной записи на
+// раздел.  Реплики занимают место в разделе своего узла
+NumaCache* create_numa_cache(int max_size, int replicate) {
+    NumaCache *numa = calloc(1, sizeof(NumaCache));
+    if (!numa) return NULL;
+    
+    numa->nodes = numa_topo_nodes();
+    numa->replicate = replicate;
+    for (int node = 0; node < numa->nodes; node++) {
+        NumaShard *shard = numa_topo_alloc(sizeof(NumaShard), node);
+        if (!shard) {
+            for (int i = 0; i < node; i++) numa_topo_free(numa->shards[i], sizeof(NumaShard));
+            free(numa);
+            return NULL;
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->head = NULL;
+        shard->tail = NULL;
+        shard->count = 0;
+        shard->max_size = max_size / numa->nodes + (node < max_size % numa->nodes);
+        if (shard->max_size < 1) shard->max_size = 1;
+        shard->invalidations = 0;
+        numa_arena_init(&shard->arena, node);
+        numa->shards[node] = shard;
+    }
+    return numa;
+}
+
+void destroy_numa_cache(NumaCache *numa) {
+    if (!numa) return;
+    for (int node = 0; node < numa->nodes; node++) {
+        NumaShard *shard = numa->shards[node];
+        // большие блоки – отдельные отображения, их надо освободить по одному
+        while (shard->head) {
+            NumaEntry *entry = shard->head;
+            numa_shard_unlink_locked(shard, entry);
+            numa_shard_free_locked(shard, entry);
+        }
+        numa_arena_destroy(&shard->arena);
+        pthread_mutex_destroy(&shard->lock);
+        numa_topo_free(shard, sizeof(NumaShard));
+    }
+    free(numa);
+}
+
+void add_to_numa_cache(NumaCache *numa, const char *key, const void *data, size_t size) {
+    if (!numa || !key || !data) return;
+    trace_record(TRACE_OP_CACHE_PUT, 0, size, key);
+    
+    InternId id = intern(key);   // 0 – запись с копией ключа
+    int home = numa_home(numa, id, key);
+    NumaShard *shard = numa->shards[home];
+    uint64_t replicas = 0;
+    
+    pthread_mutex_lock(&shard->lock);
+    int existed = numa_shard_put_locked(shard, id, key, data, size, &replicas);
+    pthread_mutex_unlock(&shard->lock);
+    
+    if (!numa->replicate) return;
+    if (!existed) replicas = ~(uint64_t)0;   // реплики вытесненной домашней записи
+    for (int i = 0; i < numa->nodes; i++) {
+        if (i != home && (replicas >> i & 1)) numa_shard_invalidate(numa->shards[i], id, key);
+    }
+}
+
+// Как get_from_cache: полный размер значения или -1
+long get_from_numa_cache(NumaCache *numa, const char *key, void *out, size_t out_size) {
+    if (!numa || !key) return -1;
+    trace_record(TRACE_OP_CACHE_GET, 0, 0, key);
+    
+    InternId id = intern_find(key);
+    if (!id && !intern_refused()) return -1;
+    int local = numa_topo_current_node() % numa->nodes;
+    int home = numa_home(numa, id, key);
+    NumaShard *mine = numa->shards[local];
+    
+    pthread_mutex_lock(&mine->lock);
+    NumaEntry *entry = numa_shard_lookup_locked(mine, id, key);
+    if (entry) {
+        if (out) memcpy(out, entry->data, entry->size < out_size ? entry->size : out_size);
+        long size = (long)entry->size;
+        pthread_mutex_unlock(&mine->lock);
+        return size;
+    }
+    unsigned long invalidations = mine->invalidations;
+    pthread_mutex_unlock(&mine->lock);
+    if (home == local) return -1;
+    
+    SCRATCH_SCOPE(scope);
+    NumaShard *owner = numa->shards[home];
+    pthread_mutex_lock(&owner->lock);
+    entry = numa_shard_lookup_locked(owner, id, key);
+    if (!entry) {
+        pthread_mutex_unlock(&owner->lock);
+        return -1;
+    }
+    if (out) memcpy(out, entry->data, entry->size < out_size ? entry->size : out_size);
+    long size = (long)entry->size;
+    void *copy = numa->replicate && entry->size ? scratch_alloc(entry->size) : NULL;
+    if (copy) {
+        memcpy(copy, entry->data, entry->size);
+        entry->replicas |= (uint64_t)1 << local;   // до копии – запись её увидит
+    }
+    pthread_mutex_unlock(&owner->lock);
+    
+    if (copy) {
+        pthread_mutex_lock(&mine->lock);
+        if (mine->invalidations == invalidations) {
+            numa_shard_put_locked(mine, id, key, copy, (size_t)size, NULL);
+        }
+        pthread_mutex_unlock(&mine->lock);
+    }
+    return size;
+}
+
+// Обработка файла: буферы из scratch-арены, на путях с ошибкой
+// достаточно закрыть файл
 int process_file_with_leak(const char *filename) {
+    trace_record(TRACE_OP_FILE_PROCESS, 0, 0, filename);
     FILE *file = fopen(filename, "r");
     if (!file) return -1;
     
-    char *buffer1 = malloc(1024);
-    char *buffer2 = malloc(2048);
+    SCRATCH_SCOPE(scope);
+    char *buffer1 = scratch_alloc(1024);
+    char *buffer2 = scratch_alloc(2048);
+    if (!buffer1 || !buffer2) {
+        fclose(file);
+        return -3;
+    }
     
     if (fgets(buffer1, 1024, file) == NULL) {
         fclose(file);
-        // УТЕЧКА: buffer1 и buffer2 не освобождаются при ошибке чтения
         return -2;
     }
     
@@ -137,13 +707,10 @@ int process_file_with_leak(const char *filename) {
     if (strlen(buffer1) > 100) {
         strcpy(buffer2, "Processing long string");
         // Какая-то обработка...
-        free(buffer1);
-        free(buffer2);
         fclose(file);
         return 1;
     } else {
         strcpy(buffer2, "Processing short string");
-        // УТЕЧКА: в этом пути забыли free
         fclose(file);
         return 0;
     }
@@ -178,6 +745,13 @@ void initialize_global_cache() {
     }
 }
 
+// Режим с разделами по NUMA-узлам; на одноузловой машине – один раздел
+void initialize_global_numa_cache(int replicate) {
+    if (!global_numa_cache) {
+        global_numa_cache = create_numa_cache(CACHE_SIZE, replicate);
+    }
+}
+
 int main(int argc, char *argv[]) {
     if (argc < 2) {
         printf("Usage: %s <mode> [file]\n", argv[0]);
@@ -209,7 +783,7 @@ int main(int argc, char *argv[]) {
             break;
         }
         case 2:
-            // Обработка файла с утечками
+            // Обработка файла: буферы из scratch-арены, утечек нет
             if (argc > 2) {
                 process_file_with_leak(argv[2]);
             }
@@ -219,7 +793,7 @@ int main(int argc, char *argv[]) {
             circular_buffer_leak();
             break;
         case 4: {
-            // Комбинированный сценарий
+            // Комбинированный сценарий: утекает только циклический буфер
             circular_buffer_leak();
             if (argc > 2) {
                 process_file_with_leak(argv[2]);
@@ -227,6 +801,25 @@ int main(int argc, char *argv[]) {
             add_to_cache(global_cache, "combo_key", "combo_data", 11);
             break;
         }
+        case 5: {
+            // Сценарий режима 1 на NumaCache: вытеснение без утечек,
+            // записи и данные живут в арене раздела своего узла
+            initialize_global_numa_cache(1);
+            char data1[] = "Important data 1";
+            char out[50];
+            
+            add_to_numa_cache(global_numa_cache, "key1", data1, sizeof(data1));
+            for (int i = 0; i < 10; i++) {
+                char key[20], value[50];
+                sprintf(key, "temp_key_%d", i);
+                sprintf(value, "temp_value_%d", i);
+                add_to_numa_cache(global_numa_cache, key, value, sizeof(value));
+            }
+            if (get_from_numa_cache(global_numa_cache, "temp_key_9", out, sizeof(out)) > 0) {
+                printf("temp_key_9 -> %s\n", out);
+            }
+            break;
+        }
     }
     
     // Глобальный кэш не освобождается - утечка при завершении
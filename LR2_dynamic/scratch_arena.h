@@ -0,0 +1,133 @@
+/*  scratch_arena.h
+ *  ─────────────────────────────────────────────────────────────────────
+ *  Потоковая scratch-арена для короткоживущих буферов.
+ *
+ *  * У каждого потока своя цепочка блоков по SCRATCH_CHUNK_SIZE байт;
+ *    выделение – сдвиг указателя, без блокировок и вызовов malloc.
+ *  * scratch_mark() запоминает текущую позицию, scratch_release()
+ *    возвращает арену к ней за O(1); блоки не освобождаются, а
+ *    переиспользуются следующими выделениями.
+ *  * SCRATCH_SCOPE(name) объявляет отметку, которая освобождается
+ *    автоматически при выходе из области видимости (__attribute__
+ *    cleanup в gcc/clang), – на любом пути return буферы возвращаются
+ *    в арену, забыть free невозможно.
+ *  * Блоки потока отдаются системе при его завершении, блоки главного
+ *    потока – в atexit.
+ *  ----------------------------------------------------------------------- */
+
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#define SCRATCH_CHUNK_SIZE (64 * 1024)
+#define SCRATCH_ALIGN      16
+
+typedef struct scratch_chunk {
+    struct scratch_chunk *next;
+    size_t size;
+    size_t used;
+    _Alignas(SCRATCH_ALIGN) char data[];
+} ScratchChunk;
+
+typedef struct {
+    ScratchChunk *chunk;
+    size_t used;
+} ScratchMark;
+
+static __thread ScratchChunk *scratch_first;     /* вся цепочка потока */
+static __thread ScratchChunk *scratch_current;   /* блок, из которого выделяем */
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+
+static void scratch_free_chain(void *first) {
+    ScratchChunk *chunk = first;
+    while (chunk) {
+        ScratchChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+static void scratch_free_main(void) {
+    scratch_free_chain(scratch_first);
+    scratch_first = scratch_current = NULL;
+}
+
+/* Destructor ключа: TLS потока ещё доступен, и указатели обнуляются –
+ * если последний поток вышел через pthread_exit, atexit вызовет
+ * scratch_free_main в нём же и не должен освободить цепочку второй раз */
+static void scratch_free_thread(void *first) {
+    scratch_free_chain(first);
+    scratch_first = scratch_current = NULL;
+}
+
+static void scratch_init_once(void) {
+    pthread_key_create(&scratch_key, scratch_free_thread);
+    atexit(scratch_free_main);
+}
+
+static ScratchChunk *scratch_new_chunk(size_t min_size) {
+    size_t size = min_size > SCRATCH_CHUNK_SIZE ? min_size : SCRATCH_CHUNK_SIZE;
+    ScratchChunk *chunk = malloc(sizeof(ScratchChunk) + size);
+    if (!chunk) return NULL;
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+static inline ScratchMark scratch_mark(void) {
+    if (!scratch_first) {
+        pthread_once(&scratch_once, scratch_init_once);
+        scratch_first = scratch_current = scratch_new_chunk(0);
+        /* у главного потока destructor ключа не вызывается – его
+         * цепочку освобождает atexit */
+        if (scratch_first) pthread_setspecific(scratch_key, scratch_first);
+    }
+    ScratchMark mark = { scratch_current, scratch_current ? scratch_current->used : 0 };
+    return mark;
+}
+
+static inline void scratch_release(ScratchMark mark) {
+    if (!mark.chunk) return;
+    scratch_current = mark.chunk;
+    scratch_current->used = mark.used;
+}
+
+static inline void scratch_release_at(ScratchMark *mark) {
+    scratch_release(*mark);
+}
+
+/* Память действительна до release отметки, взятой раньше выделения */
+static void *scratch_alloc(size_t size) {
+    ScratchChunk *chunk = scratch_current;
+    if (!chunk) return NULL;
+    size = (size + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1);
+
+    if (chunk->size - chunk->used < size) {
+        /* следующий блок остался от прошлых выделений – берём его, если
+         * он подходит, иначе вставляем новый сразу за текущим */
+        ScratchChunk *next = chunk->next;
+        if (!next || next->size < size) {
+            ScratchChunk *fresh = scratch_new_chunk(size);
+            if (!fresh) return NULL;
+            fresh->next = next;
+            chunk->next = fresh;
+            next = fresh;
+        }
+        next->used = 0;
+        chunk = scratch_current = next;
+    }
+
+    void *ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+#define SCRATCH_SCOPE(name) \
+    ScratchMark name __attribute__((cleanup(scratch_release_at))) = scratch_mark()
+
+#endif /* SCRATCH_ARENA_H */
@@ -0,0 +1,257 @@
+/*  string_intern.h
+ *  ─────────────────────────────────────────────────────────────────────
+ *  Таблица интернированных строк: одна копия на каждую различную строку.
+ *
+ *  * intern(str) возвращает InternId – 32-битный номер строки, одинаковый
+ *    для равных строк и неизменный до конца программы.  Сравнение
+ *    строк сводится к сравнению номеров.
+ *  * Для каждой строки заранее посчитаны длина и хеш; по номеру они и
+ *    сама строка читаются без блокировки (intern_str, intern_len,
+ *    intern_hash).
+ *  * Поиск по тексту идёт без блокировки: записи только добавляются,
+ *    номер попадает в индекс атомарной записью после того, как запись
+ *    заполнена, а при росте индекс перестраивается в новую таблицу и
+ *    подменяется одним атомарным указателем (как в RCU).  Старые
+ *    таблицы не освобождаются до выхода – читатель мог остаться в них,
+ *    и вместе они меньше текущей.  Мьютекс берёт только вставка новой
+ *    строки, повторив поиск под ним.  intern_find() только ищет и ничего
+ *    не добавляет – для запросов, которые не должны раздувать таблицу.
+ *  * Строки не удаляются: байты лежат подряд в блоках по
+ *    INTERN_BLOCK_SIZE, записи – в страницах по INTERN_PAGE_SIZE, поэтому
+ *    указатели на них не меняются при росте таблицы.  Всё освобождается
+ *    в atexit.  Таблица рассчитана на повторяющиеся ключи: после
+ *    INTERN_MAX_PAGES * INTERN_PAGE_SIZE строк (или при нехватке памяти)
+ *    intern() возвращает 0.  Вызывающий код тогда хранит свою копию
+ *    строки; intern_refused() сообщает, что такое уже случалось, и
+ *    строку, которой нет в таблице, надо искать ещё и по тексту.
+ *  ----------------------------------------------------------------------- */
+
+#ifndef STRING_INTERN_H
+#define STRING_INTERN_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint32_t InternId;                   /* 0 – нет строки */
+
+#define INTERN_NONE       0
+#define INTERN_PAGE_BITS  10
+#define INTERN_PAGE_SIZE  (1u << INTERN_PAGE_BITS)
+#ifndef INTERN_MAX_PAGES
+#define INTERN_MAX_PAGES  4096               /* до 4M строк */
+#endif
+#define INTERN_BLOCK_SIZE (64 * 1024)
+
+typedef struct {
+    const char *str;
+    uint32_t len;
+    uint32_t hash;
+} InternEntry;
+
+typedef struct intern_table {
+    struct intern_table *retired;            /* предыдущая, до выхода */
+    uint32_t mask;
+    InternId ids[];                          /* открытая адресация, 0 – пусто */
+} InternTable;
+
+typedef struct intern_block {
+    struct intern_block *next;
+    size_t size;
+    size_t used;
+    char data[];
+} InternBlock;
+
+static InternEntry *intern_pages[INTERN_MAX_PAGES];
+static InternId intern_next = 1;             /* номер следующей строки */
+static InternTable *intern_index;            /* читается без блокировки */
+static InternBlock *intern_blocks;
+static int intern_refusals;                  /* intern() хоть раз вернул 0 */
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint32_t intern_hash_bytes(const char *str, size_t len) {
+    uint32_t h = 2166136261u;                /* FNV-1a */
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)str[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Номер получен из intern() или из структуры, защищённой своей
+ * блокировкой, – запись уже опубликована, читать можно без intern_lock */
+static inline const InternEntry *intern_entry(InternId id) {
+    return &intern_pages[id >> INTERN_PAGE_BITS][id & (INTERN_PAGE_SIZE - 1)];
+}
+
+static inline const char *intern_str(InternId id) {
+    return id ? intern_entry(id)->str : NULL;
+}
+
+static inline uint32_t intern_len(InternId id) {
+    return id ? intern_entry(id)->len : 0;
+}
+
+static inline uint32_t intern_hash(InternId id) {
+    return id ? intern_entry(id)->hash : 0;
+}
+
+static void intern_free_all(void) {
+    pthread_mutex_lock(&intern_lock);
+    while (intern_blocks) {
+        InternBlock *next = intern_blocks->next;
+        free(intern_blocks);
+        intern_blocks = next;
+    }
+    for (int i = 0; i < INTERN_MAX_PAGES; i++) {
+        free(intern_pages[i]);
+        intern_pages[i] = NULL;
+    }
+    InternTable *table = intern_index;
+    while (table) {
+        InternTable *retired = table->retired;
+        free(table);
+        table = retired;
+    }
+    __atomic_store_n(&intern_index, NULL, __ATOMIC_RELEASE);
+    intern_next = 1;
+    intern_refusals = 0;
+    pthread_mutex_unlock(&intern_lock);
+}
+
+/* Без блокировки.  Номер или 0 и позиция для вставки (она нужна только
+ * под intern_lock, где таблица не меняется) */
+static InternId intern_lookup(const InternTable *table, const char *str, uint32_t len,
+                              uint32_t hash, uint32_t *slot) {
+    uint32_t i = hash & table->mask;
+    InternId id;
+    /* acquire-загрузка номера делает видимой запись, заполненную до него */
+    while ((id = __atomic_load_n(&table->ids[i], __ATOMIC_ACQUIRE)) != INTERN_NONE) {
+        const InternEntry *e = intern_entry(id);
+        if (e->hash == hash && e->len == len && memcmp(e->str, str, len) == 0)
+            return id;
+        i = (i + 1) & table->mask;
+    }
+    if (slot) *slot = i;
+    return INTERN_NONE;
+}
+
+/* Новая таблица вдвое больше строится целиком и только потом
+ * публикуется; старая остаётся читателям, которые в ней ищут */
+static int intern_grow_index_locked(void) {
+    InternTable *old = intern_index;
+    uint32_t cap = old ? (old->mask + 1) * 2 : 256;
+    InternTable *table = calloc(1, sizeof(InternTable) + cap * sizeof(InternId));
+    if (!table) return -1;
+    table->retired = old;
+    table->mask = cap - 1;
+    for (InternId id = 1; id < intern_next; id++) {
+        uint32_t i = intern_entry(id)->hash & table->mask;
+        while (table->ids[i]) i = (i + 1) & table->mask;
+        table->ids[i] = id;
+    }
+    __atomic_store_n(&intern_index, table, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static char *intern_store_locked(const char *str, uint32_t len) {
+    InternBlock *block = intern_blocks;
+    if (!block || block->size - block->used < (size_t)len + 1) {
+        size_t size = (size_t)len + 1 > INTERN_BLOCK_SIZE ? (size_t)len + 1 : INTERN_BLOCK_SIZE;
+        InternBlock *fresh = malloc(sizeof(InternBlock) + size);
+        if (!fresh) return NULL;
+        fresh->size = size;
+        fresh->used = 0;
+        /* блок под одну длинную строку ставится за текущим, чтобы не
+         * терять свободное место в нём */
+        if (block && size > INTERN_BLOCK_SIZE) {
+            fresh->next = block->next;
+            block->next = fresh;
+        } else {
+            fresh->next = block;
+            intern_blocks = fresh;
+        }
+        block = fresh;
+    }
+    char *copy = block->data + block->used;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    block->used += (size_t)len + 1;
+    return copy;
+}
+
+/* Номер строки; при первой встрече строка копируется в таблицу.
+ * 0 – str == NULL или не хватило памяти */
+static InternId intern(const char *str) {
+    if (!str) return INTERN_NONE;
+    size_t full_len = strlen(str);
+    if (full_len > UINT32_MAX - 1) return INTERN_NONE;
+    uint32_t len = (uint32_t)full_len;
+    uint32_t hash = intern_hash_bytes(str, len);
+    InternId id = INTERN_NONE;
+    uint32_t slot;
+
+    /* повторяющаяся строка – без блокировки */
+    InternTable *table = __atomic_load_n(&intern_index, __ATOMIC_ACQUIRE);
+    if (table && (id = intern_lookup(table, str, len, hash, NULL)) != INTERN_NONE)
+        return id;
+
+    pthread_mutex_lock(&intern_lock);
+    if (!intern_index) {
+        static int registered;
+        if (!registered) {
+            registered = 1;
+            atexit(intern_free_all);
+        }
+        if (intern_grow_index_locked() != 0) goto out;
+    }
+    /* под блокировкой: строку мог вставить другой поток */
+    id = intern_lookup(intern_index, str, len, hash, &slot);
+    if (id) goto out;
+
+    /* заполнение индекса не больше 3/4 */
+    if ((uint64_t)intern_next * 4 > (uint64_t)(intern_index->mask + 1) * 3) {
+        if (intern_grow_index_locked() != 0) goto out;
+        intern_lookup(intern_index, str, len, hash, &slot);
+    }
+
+    uint32_t page = intern_next >> INTERN_PAGE_BITS;
+    if (page >= INTERN_MAX_PAGES) goto out;
+    if (!intern_pages[page]) {
+        intern_pages[page] = malloc(INTERN_PAGE_SIZE * sizeof(InternEntry));
+        if (!intern_pages[page]) goto out;
+    }
+    const char *copy = intern_store_locked(str, len);
+    if (!copy) goto out;
+
+    id = intern_next++;
+    InternEntry *e = &intern_pages[page][id & (INTERN_PAGE_SIZE - 1)];
+    e->str = copy;
+    e->len = len;
+    e->hash = hash;
+    __atomic_store_n(&intern_index->ids[slot], id, __ATOMIC_RELEASE);
+out:
+    if (!id) __atomic_store_n(&intern_refusals, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&intern_lock);
+    return id;
+}
+
+/* 1, если intern() уже отказывал (таблица полна или не было памяти):
+ * тогда строки, которой нет в таблице, может быть копия у вызывающего */
+static inline int intern_refused(void) {
+    return __atomic_load_n(&intern_refusals, __ATOMIC_ACQUIRE);
+}
+
+/* Номер уже интернированной строки или 0, таблица не меняется */
+static inline InternId intern_find(const char *str) {
+    if (!str) return INTERN_NONE;
+    size_t full_len = strlen(str);
+    if (full_len > UINT32_MAX - 1) return INTERN_NONE;
+    uint32_t len = (uint32_t)full_len;
+    uint32_t hash = intern_hash_bytes(str, len);
+    InternTable *table = __atomic_load_n(&intern_index, __ATOMIC_ACQUIRE);
+    return table ? intern_lookup(table, str, len, hash, NULL) : INTERN_NONE;
+}
+
+#endif /* STRING_INTERN_H */
@@ -0,0 +1,211 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# --------------------------------------------------------------------
+# triage.sh – параллельный разбор находок AFL++ под Valgrind или ASan
+#
+# Все входы из <prog>_test_outputs/*/crashes и */hangs прогоняются через
+# fuzz-версию программы одновременно на всех ядрах, каждый запуск
+# ограничен таймаутом.  Находки группируются по хешу первой ошибки и
+# верхних TOP_N кадров её стека; на каждую уникальную ошибку в
+# Valgrind_results/ пишется один отчёт со списком входов и логом
+# первого из них.
+# --------------------------------------------------------------------
+
+# ---------- Конфигурация ----------
+TARGET="${1:-}"
+RESULTS_DIR="Valgrind_results"
+TOOL="${TOOL:-valgrind}"           # valgrind | asan
+JOBS="${JOBS:-$(nproc)}"
+TIMEOUT="${TIMEOUT:-10}"           # секунд на один запуск
+TOP_N="${TOP_N:-5}"                # кадров стека в сигнатуре
+
+case "$TARGET" in
+    prog_1) PROGRAM_NAME="prog_1_structs_ways_fuzz" ;;
+    prog_2) PROGRAM_NAME="prog_2_files_cache_fuzz" ;;
+    *)      PROGRAM_NAME="" ;;
+esac
+FINDINGS_DIR="${TARGET}_test_outputs"
+TRIAGE_BIN="${PROGRAM_NAME}_triage_${TOOL}"
+WORK_DIR="${TARGET}_triage"
+
+# ---------- Утилиты ----------
+log() { printf '%s\n' "$*"; }
+
+# ---------- Компиляция программы ----------
+compile_program() {
+    log "Компиляция $PROGRAM_NAME для $TOOL…"
+    #  Обычный gcc без инструментации AFL: -O0 -g и frame pointer'ы
+    #  дают полные стеки с номерами строк
+    local flags=(-O0 -g -fno-omit-frame-pointer)
+    if [[ $TOOL == asan ]]; then
+        flags+=(-fsanitize=address)
+    elif ! command -v valgrind &>/dev/null; then
+        log "Valgrind не найден. Установите его: sudo apt install valgrind"
+        exit 1
+    fi
+    gcc "${flags[@]}" -o "$TRIAGE_BIN" "$PROGRAM_NAME".c -lpthread
+    log "Бинарник $TRIAGE_BIN готов."
+}
+
+# ---------- Прогон одной находки ----------
+# Пишет <job>.log с выводом инструмента и <job>.sig со строкой
+# "хеш<TAB>статус<TAB>заголовок<TAB>вход".
+replay_one() {
+    local input=$1
+    local job
+    job="$WORK_DIR/$(printf '%s' "$input" | cksum | cut -d' ' -f1)"
+    local status=0
+
+    if [[ $TOOL == asan ]]; then
+        ASAN_OPTIONS=detect_leaks=0:abort_on_error=0 \
+            timeout -k 2 "$TIMEOUT" ./"$TRIAGE_BIN" < "$input" \
+            > /dev/null 2> "$job.log" || status=$?
+    else
+        timeout -k 2 "$TIMEOUT" valgrind -q --error-exitcode=99 --leak-check=no \
+            --track-origins=yes --log-file="$job.log" ./"$TRIAGE_BIN" < "$input" \
+            > /dev/null 2>&1 || status=$?
+    fi
+
+    # Первая ошибка и её верхние кадры: функция + файл без номера строки.
+    # Кадры рантайма инструмента пропускаются, повторы при рекурсии
+    # схлопываются – иначе каждое переполнение стека было бы «новым».
+    local sig
+    sig=$(awk -v top="$TOP_N" '
+        function add_frame(f) {
+            if (f ~ /libsanitizer|vgpreload|valgrind\/|\(in \/(usr\/)?lib/) return
+            sub(/ \/([^ ]*\/)?/, " ", f)
+            if (f == last) return
+            stack = stack " | " f; last = f; frames++
+        }
+        { sub(/^==[0-9]+== ?/, "") }
+        title == "" && /^(Invalid |Conditional jump|Use of uninitialised|Syscall param|Mismatched free|Source and destination|Process terminating)/ {
+            title = $0; next
+        }
+        title == "" && /ERROR: AddressSanitizer:/ {
+            title = $0; sub(/ on address.*/, "", title); sub(/^.*ERROR: /, "", title); next
+        }
+        title != "" && frames < top && /^ *(at|by) 0x[0-9A-Fa-f]+: / {
+            sub(/^ *(at|by) 0x[0-9A-Fa-f]+: /, ""); sub(/:[0-9]+\)$/, ")")
+            add_frame($0); next
+        }
+        title != "" && frames < top && /^ *#[0-9]+ 0x[0-9a-f]+ in / {
+            sub(/^ *#[0-9]+ 0x[0-9a-f]+ in /, ""); sub(/:[0-9]+(:[0-9]+)?$/, "")
+            add_frame($0); next
+        }
+        title != "" && frames > 0 && !/^ *(at|by|#[0-9]+) / { frames = top }
+        END { printf "%s%s", title, stack }
+    ' "$job.log")
+
+    local kind="CRASH"
+    if (( status == 124 || status == 137 )); then
+        kind="HANG"
+    elif [[ -z $sig ]]; then
+        kind="NO_REPRO"
+    fi
+    [[ -z $sig ]] && sig="$kind"
+
+    local hash
+    hash=$(printf '%s' "$sig" | cksum | cut -d' ' -f1)
+    printf '%s\t%s\t%s\t%s\n' "$hash" "$kind" "$sig" "$input" > "$job.sig"
+}
+
+# ---------- Прогон всех находок ----------
+run_triage() {
+    if [[ ! -d $FINDINGS_DIR ]]; then
+        log "Нет каталога $FINDINGS_DIR – сначала запустите ./${TARGET}_fuzz.sh fuzz"
+        exit 1
+    fi
+    compile_program
+    rm -rf "$WORK_DIR"
+    mkdir -p "$WORK_DIR" "$RESULTS_DIR"
+
+    local total
+    total=$(find "$FINDINGS_DIR" -type f -path '*/crashes/id:*' -o -type f -path '*/hangs/id:*' | wc -l)
+    log "Находок: $total, параллельно: $JOBS, таймаут: ${TIMEOUT}s"
+
+    export TOOL TIMEOUT TOP_N TRIAGE_BIN WORK_DIR
+    export -f replay_one
+    find "$FINDINGS_DIR" -type f \( -path '*/crashes/id:*' -o -path '*/hangs/id:*' \) -print0 |
+        xargs -0 -r -P "$JOBS" -n 1 bash -c 'replay_one "$0"'
+
+    write_reports
+}
+
+# ---------- Отчёты по уникальным ошибкам ----------
+write_reports() {
+    local index="$WORK_DIR/index.tsv"
+    find "$WORK_DIR" -name '*.sig' -exec cat {} + 2>/dev/null | sort > "$index" || true
+
+    local unique=0
+    for hash in $(cut -f1 "$index" | sort -u); do
+        local report="$RESULTS_DIR/triage_${TARGET}_${TOOL}_${hash}.txt"
+        local first kind title count first_log
+        first=$(awk -F'\t' -v h="$hash" '$1 == h { print $4; exit }' "$index")
+        kind=$(awk -F'\t' -v h="$hash" '$1 == h { print $2; exit }' "$index")
+        title=$(awk -F'\t' -v h="$hash" '$1 == h { print $3; exit }' "$index")
+        count=$(awk -F'\t' -v h="$hash" '$1 == h' "$index" | wc -l)
+        first_log="$WORK_DIR/$(printf '%s' "$first" | cksum | cut -d' ' -f1).log"
+
+        {
+            echo "Program:   $PROGRAM_NAME ($TOOL)"
+            echo "Kind:      $kind"
+            echo "Signature: $title"
+            echo "Inputs:    $count"
+            awk -F'\t' -v h="$hash" '$1 == h { print "    " $4 }' "$index"
+            echo
+            echo "---------- $first ----------"
+            cat "$first_log"
+        } > "$report"
+        log "  [$kind] x$count  $title"
+        unique=$((unique + 1))
+    done
+    log "Уникальных ошибок: $unique, отчёты – $RESULTS_DIR/triage_${TARGET}_${TOOL}_*.txt"
+}
+
+# ---------- Очистка ----------
+cleanup() {
+    log "Удаляем всё, что было создано…"
+    rm -f "${PROGRAM_NAME}"_triage_*
+    rm -rf "$WORK_DIR"
+    rm -f "$RESULTS_DIR"/triage_"${TARGET}"_*.txt
+    log "Очистка завершена."
+}
+
+# ---------- Показать помощь ----------
+show_usage() {
+    cat <<'EOF'
+Использование:
+  ./triage.sh prog_1|prog_2 run     - Прогнать все crashes/hangs и записать отчёты
+  ./triage.sh prog_1|prog_2 clean   - Удалить бинарники, рабочие файлы и отчёты
+
+Переменные окружения:
+  TOOL=valgrind|asan   инструмент (valgrind)
+  JOBS=<n>             число параллельных запусков (nproc)
+  TIMEOUT=<s>          таймаут одного запуска, секунд (10)
+  TOP_N=<n>            кадров стека в сигнатуре (5)
+EOF
+}
+
+# ---------- Основная логика ----------
+if [[ -z $PROGRAM_NAME ]]; then
+    show_usage
+    exit 1
+fi
+
+case "${2:-}" in
+    run)
+        run_triage
+        ;;
+    clean)
+        cleanup
+        ;;
+    "")
+        show_usage
+        ;;
+    *)
+        echo "Неизвестная команда: $2"
+        show_usage
+        exit 1
+        ;;
+esac
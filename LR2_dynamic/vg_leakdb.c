@@ -0,0 +1,529 @@
+/*  vg_leakdb.c
+ *  ─────────────────────────────────────────────────────────────────────
+ *  Разбор отчётов memcheck из Valgrind_results/ в структурированные
+ *  записи и база для отслеживания регрессий по утечкам.
+ *
+ *  * Логи читаются потоково, построчно; из каждой записи вида
+ *        ==N== 5 bytes in 1 blocks are definitely lost in loss record 1 of 12
+ *        ==N==    at 0x4846828: malloc (in /usr/libexec/valgrind/...)
+ *        ==N==    by 0x1094F3: add_to_cache (prog_2_files_cache.c:72)
+ *    извлекаются вид потери, байты, блоки и кадры стека.  Отчёты
+ *    leak_tracker.c имеют тот же формат и разбираются так же.
+ *  * Одинаковые записи из разных логов сливаются по сигнатуре: вид
+ *    потери + функции и файлы кадров + строка первого кадра с исходным
+ *    кодом (места выделения).  Строка места выделения различает два
+ *    malloc в одной функции – иначе исправление одного скрыло бы рост
+ *    другого.  Номера строк внешних кадров в сигнатуру не входят, чтобы
+ *    правка вызывающего кода не превращала старую утечку в «новую», но
+ *    сохраняются для вывода.
+ *  * Байты и блоки записи – максимум за один лог (внутри лога одинаковые
+ *    записи суммируются).  Поэтому compare не зависит от того, сколько
+ *    логов собрано в каждую базу: три прогона в базовой против одного в
+ *    текущей сравниваются как прогон с прогоном.
+ *  * База – один файл: заголовок, записи, отсортированные по сигнатуре
+ *    (это и есть индекс – поиск бинарный), кадры и пул строк без
+ *    повторов.  Порядок байтов – родной для машины.
+ *
+ *  Компиляция:
+ *      gcc -O2 -g -o vg_leakdb vg_leakdb.c
+ *
+ *  Использование:
+ *      ./vg_leakdb import <db> <log>...          – собрать базу из логов
+ *      ./vg_leakdb dump <db>                     – вывести записи
+ *      ./vg_leakdb compare [--all] <old> <new>   – новые и выросшие утечки
+ *
+ *  compare завершается с кодом 1, если найдена хотя бы одна регрессия;
+ *  still reachable учитывается только с --all.
+ *  ----------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DB_MAGIC   "VGLEAKDB"
+#define DB_VERSION 3
+
+enum { KIND_DEFINITE, KIND_INDIRECT, KIND_POSSIBLE, KIND_REACHABLE, KIND_COUNT };
+
+static const char *kind_names[KIND_COUNT] = {
+    "definitely lost", "indirectly lost", "possibly lost", "still reachable",
+};
+
+/* ---------------------------------------------------------------------- */
+/*  Формат файла                                                           */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_count;
+    uint32_t frame_count;
+    uint32_t string_count;
+    uint64_t pool_size;
+} DbHeader;
+
+typedef struct {
+    uint64_t sig;
+    uint64_t bytes;           /* максимум за один лог */
+    uint64_t blocks;          /* максимум за один лог */
+    uint32_t kind;
+    uint32_t logs;            /* в скольких логах встретилась запись */
+    uint32_t first_frame;
+    uint32_t frame_count;
+} DbRecord;
+
+typedef struct {
+    uint32_t func;            /* индексы в пуле строк */
+    uint32_t loc;             /* "file.c:72" или "in /path/module" */
+} DbFrame;
+
+typedef struct {
+    DbHeader hdr;
+    DbRecord *records;
+    DbFrame *frames;
+    uint32_t *string_offsets;
+    char *pool;
+} LeakDb;
+
+/* ---------------------------------------------------------------------- */
+/*  Построение базы в памяти                                               */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    LeakDb db;
+    size_t records_cap, frames_cap, strings_cap, pool_cap, last_log_cap;
+    size_t log_bytes_cap, log_blocks_cap;
+    uint32_t *record_index;   /* хеш сигнатура -> запись + 1 */
+    uint32_t *string_index;   /* хеш строка -> строка + 1 */
+    uint32_t *last_log;       /* последний лог, в котором была запись */
+    uint64_t *log_bytes;      /* сумма записи в последнем логе */
+    uint64_t *log_blocks;
+    size_t record_index_cap, string_index_cap;
+} Builder;
+
+static void *xrealloc(void *ptr, size_t size) {
+    void *p = realloc(ptr, size);
+    if (!p) {
+        fprintf(stderr, "Недостаточно памяти\n");
+        exit(2);
+    }
+    return p;
+}
+
+#define GROW(ptr, cap, need)                                        \
+    do {                                                            \
+        if ((need) > (cap)) {                                       \
+            (cap) = (cap) ? (cap) * 2 : 64;                         \
+            while ((cap) < (need)) (cap) *= 2;                      \
+            (ptr) = xrealloc((ptr), (cap) * sizeof(*(ptr)));        \
+        }                                                           \
+    } while (0)
+
+static uint64_t fnv1a(const char *s, size_t len, uint64_t h) {
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+#define FNV_SEED 0xcbf29ce484222325ULL
+
+static const char *db_string(const LeakDb *db, uint32_t id) {
+    return db->pool + db->string_offsets[id];
+}
+
+static void rehash(uint32_t **index, size_t *cap, size_t count,
+                   uint64_t (*key_of)(const Builder *, uint32_t), const Builder *b) {
+    size_t new_cap = *cap ? *cap * 2 : 1024;
+    uint32_t *fresh = xrealloc(NULL, new_cap * sizeof(uint32_t));
+    memset(fresh, 0, new_cap * sizeof(uint32_t));
+    for (uint32_t id = 0; id < count; id++) {
+        size_t slot = key_of(b, id) & (new_cap - 1);
+        while (fresh[slot]) slot = (slot + 1) & (new_cap - 1);
+        fresh[slot] = id + 1;
+    }
+    free(*index);
+    *index = fresh;
+    *cap = new_cap;
+}
+
+static uint64_t string_key(const Builder *b, uint32_t id) {
+    const char *s = db_string(&b->db, id);
+    return fnv1a(s, strlen(s), FNV_SEED);
+}
+
+static uint64_t record_key(const Builder *b, uint32_t id) {
+    return b->db.records[id].sig;
+}
+
+static uint32_t intern_string(Builder *b, const char *s, size_t len) {
+    LeakDb *db = &b->db;
+    if ((db->hdr.string_count + 1) * 2 > b->string_index_cap)
+        rehash(&b->string_index, &b->string_index_cap, db->hdr.string_count, string_key, b);
+
+    uint64_t h = fnv1a(s, len, FNV_SEED);
+    size_t slot = h & (b->string_index_cap - 1);
+    while (b->string_index[slot]) {
+        const char *cur = db_string(db, b->string_index[slot] - 1);
+        if (strncmp(cur, s, len) == 0 && cur[len] == '\0') return b->string_index[slot] - 1;
+        slot = (slot + 1) & (b->string_index_cap - 1);
+    }
+
+    uint32_t id = db->hdr.string_count++;
+    GROW(db->string_offsets, b->strings_cap, db->hdr.string_count);
+    GROW(db->pool, b->pool_cap, db->hdr.pool_size + len + 1);
+    db->string_offsets[id] = (uint32_t)db->hdr.pool_size;
+    memcpy(db->pool + db->hdr.pool_size, s, len);
+    db->pool[db->hdr.pool_size + len] = '\0';
+    db->hdr.pool_size += len + 1;
+    b->string_index[slot] = id + 1;
+    return id;
+}
+
+/* Запись, которую сейчас собирает парсер */
+typedef struct {
+    int active;
+    uint32_t kind;
+    uint64_t bytes, blocks;
+    size_t frame_count;
+    DbFrame frames[64];
+} Pending;
+
+/* Сигнатура: вид + функции + файлы/модули без смещений; номер строки –
+ * только у первого кадра с исходным кодом ("file.c:72"), кадры
+ * аллокатора и модулей без отладочной информации до него пропускаются */
+static uint64_t pending_sig(const LeakDb *db, const Pending *p) {
+    uint64_t h = fnv1a((const char *)&p->kind, sizeof(p->kind), FNV_SEED);
+    int site_seen = 0;
+    for (size_t i = 0; i < p->frame_count; i++) {
+        const char *func = db_string(db, p->frames[i].func);
+        const char *loc = db_string(db, p->frames[i].loc);
+        size_t len = strcspn(loc, ":+");
+        if (!site_seen && loc[len] == ':') {
+            site_seen = 1;
+            len = strlen(loc);
+        }
+        h = fnv1a(func, strlen(func) + 1, h);
+        h = fnv1a(loc, len, h);
+    }
+    return h;
+}
+
+static void commit_pending(Builder *b, Pending *p, uint32_t log_id) {
+    LeakDb *db = &b->db;
+    if (!p->active) return;
+    p->active = 0;
+
+    if ((db->hdr.record_count + 1) * 2 > b->record_index_cap)
+        rehash(&b->record_index, &b->record_index_cap, db->hdr.record_count, record_key, b);
+
+    uint64_t sig = pending_sig(db, p);
+    size_t slot = sig & (b->record_index_cap - 1);
+    while (b->record_index[slot]) {
+        uint32_t id = b->record_index[slot] - 1;
+        if (db->records[id].sig == sig) {
+            DbRecord *r = &db->records[id];
+            if (b->last_log[id] != log_id) {
+                b->last_log[id] = log_id;
+                b->log_bytes[id] = b->log_blocks[id] = 0;
+                r->logs++;
+            }
+            b->log_bytes[id] += p->bytes;
+            b->log_blocks[id] += p->blocks;
+            if (b->log_bytes[id] > r->bytes) r->bytes = b->log_bytes[id];
+            if (b->log_blocks[id] > r->blocks) r->blocks = b->log_blocks[id];
+            return;
+        }
+        slot = (slot + 1) & (b->record_index_cap - 1);
+    }
+
+    uint32_t id = db->hdr.record_count++;
+    GROW(db->records, b->records_cap, db->hdr.record_count);
+    GROW(b->last_log, b->last_log_cap, db->hdr.record_count);
+    GROW(b->log_bytes, b->log_bytes_cap, db->hdr.record_count);
+    GROW(b->log_blocks, b->log_blocks_cap, db->hdr.record_count);
+    GROW(db->frames, b->frames_cap, db->hdr.frame_count + p->frame_count);
+
+    db->records[id] = (DbRecord){
+        .sig = sig, .bytes = p->bytes, .blocks = p->blocks, .kind = p->kind,
+        .logs = 1, .first_frame = db->hdr.frame_count, .frame_count = (uint32_t)p->frame_count,
+    };
+    memcpy(db->frames + db->hdr.frame_count, p->frames, p->frame_count * sizeof(DbFrame));
+    db->hdr.frame_count += (uint32_t)p->frame_count;
+    b->last_log[id] = log_id;
+    b->log_bytes[id] = p->bytes;
+    b->log_blocks[id] = p->blocks;
+    b->record_index[slot] = id + 1;
+}
+
+/* ---------------------------------------------------------------------- */
+/*  Разбор логов                                                           */
+/* ---------------------------------------------------------------------- */
+
+/* "1,260" -> 1260; сдвигает *s за число */
+static uint64_t parse_number(const char **s) {
+    uint64_t v = 0;
+    while (**s == ',' || (**s >= '0' && **s <= '9')) {
+        if (**s != ',') v = v * 10 + (uint64_t)(**s - '0');
+        (*s)++;
+    }
+    return v;
+}
+
+/* Срезает префикс "==1234== " */
+static const char *strip_pid(const char *line) {
+    if (line[0] != '=' || line[1] != '=') return NULL;
+    const char *p = line + 2;
+    while (*p >= '0' && *p <= '9') p++;
+    if (p[0] != '=' || p[1] != '=') return NULL;
+    p += 2;
+    return *p == ' ' ? p + 1 : p;
+}
+
+/* "5 bytes in 1 blocks are definitely lost in loss record 1 of 12"
+ * "24 (8 direct, 16 indirect) bytes in 1 blocks are definitely lost ..." */
+static int parse_record_header(const char *s, Pending *p) {
+    if (*s < '0' || *s > '9') return 0;
+    uint64_t bytes = parse_number(&s);
+    if (*s == ' ' && s[1] == '(') {
+        s = strchr(s, ')');
+        if (!s) return 0;
+        s++;
+    }
+    if (strncmp(s, " bytes in ", 10) != 0) return 0;
+    s += 10;
+    uint64_t blocks = parse_number(&s);
+    if (strncmp(s, " blocks are ", 12) != 0) return 0;
+    s += 12;
+
+    for (uint32_t k = 0; k < KIND_COUNT; k++) {
+        size_t len = strlen(kind_names[k]);
+        if (strncmp(s, kind_names[k], len) == 0 && strncmp(s + len, " in loss record", 15) == 0) {
+            p->active = 1;
+            p->kind = k;
+            p->bytes = bytes;
+            p->blocks = blocks;
+            p->frame_count = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* "   by 0x1094F3: add_to_cache (prog_2_files_cache.c:72)" */
+static int parse_frame(Builder *b, const char *s, Pending *p) {
+    while (*s == ' ') s++;
+    if (strncmp(s, "at ", 3) != 0 && strncmp(s, "by ", 3) != 0) return 0;
+    s = strstr(s, ": ");
+    if (!s) return 0;
+    s += 2;
+
+    const char *open = strrchr(s, '(');
+    const char *close = open ? strrchr(open, ')') : NULL;
+    const char *func_end = open ? open : s + strcspn(s, "\r\n");
+    while (func_end > s && func_end[-1] == ' ') func_end--;
+
+    if (p->frame_count < sizeof(p->frames) / sizeof(p->frames[0])) {
+        DbFrame *f = &p->frames[p->frame_count++];
+        f->func = intern_string(b, s, (size_t)(func_end - s));
+        f->loc = close ? intern_string(b, open + 1, (size_t)(close - open - 1))
+                       : intern_string(b, "", 0);
+    }
+    return 1;
+}
+
+static int import_log(Builder *b, const char *path, uint32_t log_id) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    static char buffer[1 << 16];
+    setvbuf(file, NULL, _IOFBF, 1 << 16);
+
+    Pending pending = {0};
+    while (fgets(buffer, sizeof(buffer), file)) {
+        const char *s = strip_pid(buffer);
+        if (!s) continue;
+        if (pending.active) {
+            if (parse_frame(b, s, &pending)) continue;
+            commit_pending(b, &pending, log_id);   /* пустая строка – конец записи */
+        }
+        parse_record_header(s, &pending);
+    }
+    commit_pending(b, &pending, log_id);
+    fclose(file);
+    return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+/*  Чтение и запись файла базы                                             */
+/* ---------------------------------------------------------------------- */
+
+static int cmp_record_sig(const void *a, const void *b) {
+    uint64_t x = ((const DbRecord *)a)->sig, y = ((const DbRecord *)b)->sig;
+    return (x > y) - (x < y);
+}
+
+static int db_write(LeakDb *db, const char *path) {
+    qsort(db->records, db->hdr.record_count, sizeof(DbRecord), cmp_record_sig);
+    memcpy(db->hdr.magic, DB_MAGIC, 8);
+    db->hdr.version = DB_VERSION;
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    int ok = fwrite(&db->hdr, sizeof(db->hdr), 1, file) == 1
+          && fwrite(db->records, sizeof(DbRecord), db->hdr.record_count, file) == db->hdr.record_count
+          && fwrite(db->frames, sizeof(DbFrame), db->hdr.frame_count, file) == db->hdr.frame_count
+          && fwrite(db->string_offsets, sizeof(uint32_t), db->hdr.string_count, file) == db->hdr.string_count
+          && fwrite(db->pool, 1, db->hdr.pool_size, file) == db->hdr.pool_size;
+    if (fclose(file) != 0) ok = 0;
+    if (!ok) fprintf(stderr, "%s: ошибка записи\n", path);
+    return ok ? 0 : -1;
+}
+
+static int db_read(LeakDb *db, const char *path) {
+    memset(db, 0, sizeof(*db));
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    int ok = fread(&db->hdr, sizeof(db->hdr), 1, file) == 1
+          && memcmp(db->hdr.magic, DB_MAGIC, 8) == 0
+          && db->hdr.version == DB_VERSION;
+    if (ok) {
+        db->records = xrealloc(NULL, (db->hdr.record_count + 1) * sizeof(DbRecord));
+        db->frames = xrealloc(NULL, (db->hdr.frame_count + 1) * sizeof(DbFrame));
+        db->string_offsets = xrealloc(NULL, (db->hdr.string_count + 1) * sizeof(uint32_t));
+        db->pool = xrealloc(NULL, db->hdr.pool_size + 1);
+        ok = fread(db->records, sizeof(DbRecord), db->hdr.record_count, file) == db->hdr.record_count
+          && fread(db->frames, sizeof(DbFrame), db->hdr.frame_count, file) == db->hdr.frame_count
+          && fread(db->string_offsets, sizeof(uint32_t), db->hdr.string_count, file) == db->hdr.string_count
+          && fread(db->pool, 1, db->hdr.pool_size, file) == db->hdr.pool_size;
+    }
+    fclose(file);
+    if (!ok) fprintf(stderr, "%s: не является базой vg_leakdb или повреждён\n", path);
+    return ok ? 0 : -1;
+}
+
+static void db_free(LeakDb *db) {
+    free(db->records);
+    free(db->frames);
+    free(db->string_offsets);
+    free(db->pool);
+}
+
+static const DbRecord *db_find(const LeakDb *db, uint64_t sig) {
+    DbRecord key = { .sig = sig };
+    return bsearch(&key, db->records, db->hdr.record_count, sizeof(DbRecord), cmp_record_sig);
+}
+
+static void print_record(const LeakDb *db, const char *tag, const DbRecord *r) {
+    printf("%s%llu bytes in %llu blocks are %s (logs: %u, sig %016llx)\n", tag,
+           (unsigned long long)r->bytes, (unsigned long long)r->blocks,
+           kind_names[r->kind < KIND_COUNT ? r->kind : 0], r->logs, (unsigned long long)r->sig);
+    for (uint32_t i = 0; i < r->frame_count; i++) {
+        const DbFrame *f = &db->frames[r->first_frame + i];
+        printf("    %s %s (%s)\n", i == 0 ? "at" : "by",
+               db_string(db, f->func), db_string(db, f->loc));
+    }
+}
+
+/* ---------------------------------------------------------------------- */
+/*  Команды                                                                */
+/* ---------------------------------------------------------------------- */
+
+static int cmd_import(int argc, char *argv[]) {
+    Builder b;
+    memset(&b, 0, sizeof(b));
+    int failed = 0;
+    for (int i = 1; i < argc; i++)
+        if (import_log(&b, argv[i], (uint32_t)i) != 0) failed++;
+
+    int rc = db_write(&b.db, argv[0]);
+    if (rc == 0)
+        fprintf(stderr, "%s: %u записей из %d логов\n", argv[0],
+                b.db.hdr.record_count, argc - 1 - failed);
+    db_free(&b.db);
+    free(b.record_index);
+    free(b.string_index);
+    free(b.last_log);
+    free(b.log_bytes);
+    free(b.log_blocks);
+    return rc == 0 && !failed ? 0 : 2;
+}
+
+static int cmd_dump(const char *path) {
+    LeakDb db;
+    if (db_read(&db, path) != 0) return 2;
+    for (uint32_t i = 0; i < db.hdr.record_count; i++) {
+        print_record(&db, "", &db.records[i]);
+        printf("\n");
+    }
+    db_free(&db);
+    return 0;
+}
+
+static int cmd_compare(const char *old_path, const char *new_path, int all_kinds) {
+    LeakDb old_db, new_db;
+    if (db_read(&old_db, old_path) != 0) return 2;
+    if (db_read(&new_db, new_path) != 0) {
+        db_free(&old_db);
+        return 2;
+    }
+
+    unsigned regressions = 0, fixed = 0;
+    for (uint32_t i = 0; i < new_db.hdr.record_count; i++) {
+        const DbRecord *r = &new_db.records[i];
+        if (r->kind == KIND_REACHABLE && !all_kinds) continue;
+        const DbRecord *was = db_find(&old_db, r->sig);
+        if (!was) {
+            print_record(&new_db, "NEW   ", r);
+            regressions++;
+        } else if (r->bytes > was->bytes) {
+            printf("GROWN +%llu bytes (было %llu) ",
+                   (unsigned long long)(r->bytes - was->bytes), (unsigned long long)was->bytes);
+            print_record(&new_db, "", r);
+            regressions++;
+        }
+    }
+    for (uint32_t i = 0; i < old_db.hdr.record_count; i++) {
+        const DbRecord *r = &old_db.records[i];
+        if (r->kind == KIND_REACHABLE && !all_kinds) continue;
+        if (!db_find(&new_db, r->sig)) {
+            print_record(&old_db, "FIXED ", r);
+            fixed++;
+        }
+    }
+    printf("Регрессий: %u, исправлено: %u\n", regressions, fixed);
+
+    db_free(&old_db);
+    db_free(&new_db);
+    return regressions ? 1 : 0;
+}
+
+static void show_usage(const char *prog) {
+    printf("Usage: %s import <db> <log>...\n"
+           "       %s dump <db>\n"
+           "       %s compare [--all] <old_db> <new_db>\n", prog, prog, prog);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 4 && strcmp(argv[1], "import") == 0)
+        return cmd_import(argc - 2, argv + 2);
+    if (argc == 3 && strcmp(argv[1], "dump") == 0)
+        return cmd_dump(argv[2]);
+    if (argc == 4 && strcmp(argv[1], "compare") == 0)
+        return cmd_compare(argv[2], argv[3], 0);
+    if (argc == 5 && strcmp(argv[1], "compare") == 0 && strcmp(argv[2], "--all") == 0)
+        return cmd_compare(argv[3], argv[4], 1);
+
+    show_usage(argv[0]);
+    return 2;
+}
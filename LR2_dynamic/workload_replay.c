@@ -0,0 +1,370 @@
+/*  workload_replay.c
+ *  ─────────────────────────────────────────────────────────────────────
+ *  Многопоточное воспроизведение трасс, записанных через
+ *  workload_trace.h (WORKLOAD_TRACE=<file> ./prog_2_files_cache ...).
+ *
+ *  * Трасса целиком читается в память до старта замеров.
+ *  * Операции раздаются потокам по номеру исходного потока
+ *    (thread % --threads), порядок внутри потока сохраняется.
+ *  * --speed 1 воспроизводит исходные интервалы, --speed 10 – в десять
+ *    раз быстрее, --speed 0 – без пауз, с максимальной скоростью.
+ *  * Все потоки работают с одним кэшем и одним списком, как в исходной
+ *    программе.  List не потокобезопасен, поэтому операции со списком
+ *    сериализуются отдельным мьютексом – его ожидание входит в задержку.
+ *  * --reclaim <n> включает у кэша фоновый поток освобождения
+ *    (cache_start_reclaimer): 0 – только отложенный free, n > 0 – ещё и
+ *    фоновое вытеснение выше n записей.  Так сравнивается p99 вставки
+ *    с вытеснением под блокировкой и без него.
+ *  * --free-evicted – синхронная база для этого сравнения: вытеснение
+ *    под блокировкой освобождает запись вместе с данными, как и фоновый
+ *    поток.  Без него исходный кэш теряет данные вытесненных записей, и
+ *    синхронный вариант выглядит быстрее, чем был бы без утечки.
+ *  * Отчёт – JSON: пропускная способность, перцентили задержки по видам
+ *    операций и пик RSS процесса (ru_maxrss).  Пик снимается ещё раз
+ *    после загрузки трассы и выделения буферов задержек (baseline_rss_kb),
+ *    rss_growth_kb – на сколько пик вырос за само воспроизведение.
+ *
+ *  Компиляция:
+ *      gcc -O2 -g -o workload_replay workload_replay.c -pthread
+ *
+ *  Запуск:
+ *      WORKLOAD_TRACE=cache.trace ./prog_2_files_cache 1
+ *      ./workload_replay --speed 0 --threads 4 cache.trace
+ *      ./workload_replay --speed 0 --cache-size 64 --free-evicted cache.trace
+ *      ./workload_replay --speed 0 --cache-size 64 --reclaim 48 cache.trace
+ *      ./workload_replay --dump cache.trace
+ *  ----------------------------------------------------------------------- */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#define main prog_1_main
+#include "prog_1_structs_ways.c"
+#undef main
+#define main prog_2_main
+#include "prog_2_files_cache.c"
+#undef main
+
+static const char *op_names[TRACE_OP_COUNT] = {
+    "", "cache_put", "cache_get", "list_add", "list_remove", "file_process",
+};
+
+/* ---------------------------------------------------------------------- */
+/*  Загрузка трассы                                                        */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    TraceRecord rec;
+    const char *key;              /* строка-аргумент, с завершающим нулём */
+} Op;
+
+typedef struct {
+    Op *ops;
+    size_t count;
+    char *strings;                /* все строки трассы подряд */
+    uint32_t threads;             /* потоков в исходной записи */
+    uint32_t max_size;            /* наибольший размер значения */
+} Trace;
+
+static int load_trace(const char *path, Trace *trace) {
+    memset(trace, 0, sizeof(*trace));
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+
+    TraceHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, file) != 1 || memcmp(hdr.magic, TRACE_MAGIC, 8) != 0) {
+        fprintf(stderr, "%s: не является трассой workload_trace\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    /* два прохода не нужны: строки копим в растущий буфер, а указатели
+     * на них проставляем после чтения, когда буфер уже не переедет */
+    size_t ops_cap = 1024, strings_cap = 1 << 16, strings_len = 0;
+    size_t *offsets = malloc(ops_cap * sizeof(size_t));
+    trace->ops = malloc(ops_cap * sizeof(Op));
+    trace->strings = malloc(strings_cap);
+    if (!offsets || !trace->ops || !trace->strings) goto oom;
+
+    TraceRecord rec;
+    while (fread(&rec, sizeof(rec), 1, file) == 1) {
+        if (trace->count == ops_cap) {
+            ops_cap *= 2;
+            Op *ops = realloc(trace->ops, ops_cap * sizeof(Op));
+            size_t *offs = realloc(offsets, ops_cap * sizeof(size_t));
+            if (ops) trace->ops = ops;
+            if (offs) offsets = offs;
+            if (!ops || !offs) goto oom;
+        }
+        if (strings_len + rec.key_len + 1 > strings_cap) {
+            while (strings_len + rec.key_len + 1 > strings_cap) strings_cap *= 2;
+            char *strings = realloc(trace->strings, strings_cap);
+            if (!strings) goto oom;
+            trace->strings = strings;
+        }
+        if (rec.key_len && fread(trace->strings + strings_len, 1, rec.key_len, file) != rec.key_len) {
+            fprintf(stderr, "%s: трасса обрезана\n", path);
+            break;
+        }
+        trace->strings[strings_len + rec.key_len] = '\0';
+        offsets[trace->count] = strings_len;
+        strings_len += rec.key_len + 1;
+
+        trace->ops[trace->count++].rec = rec;
+        if (rec.thread + 1 > trace->threads) trace->threads = rec.thread + 1;
+        if (rec.size > trace->max_size) trace->max_size = rec.size;
+    }
+    fclose(file);
+
+    for (size_t i = 0; i < trace->count; i++)
+        trace->ops[i].key = trace->strings + offsets[i];
+    free(offsets);
+    return 0;
+
+oom:
+    fprintf(stderr, "Недостаточно памяти для трассы\n");
+    fclose(file);
+    free(offsets);
+    free(trace->ops);
+    free(trace->strings);
+    return -1;
+}
+
+/* ---------------------------------------------------------------------- */
+/*  Воспроизведение                                                        */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    const Trace *trace;
+    int index, threads;
+    double speed;
+    uint64_t start_ns;
+    uint64_t *latencies[TRACE_OP_COUNT];   /* по видам операций */
+    size_t capacity[TRACE_OP_COUNT];       /* операций этого потока в трассе */
+    size_t counts[TRACE_OP_COUNT];
+} Worker;
+
+static Cache *replay_cache;
+static List *replay_list;
+static pthread_mutex_t list_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *replay_value;                 /* содержимое значений неважно */
+static pthread_barrier_t start_barrier;
+
+static uint64_t now_ns(void) {
+    return trace_now_ns(CLOCK_MONOTONIC);
+}
+
+static void wait_until(uint64_t deadline_ns) {
+    if (now_ns() >= deadline_ns) return;
+    struct timespec ts = {
+        .tv_sec = (time_t)(deadline_ns / 1000000000ULL),
+        .tv_nsec = (long)(deadline_ns % 1000000000ULL),
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+        ;
+}
+
+static void execute(const Op *op) {
+    char out[256];
+    switch (op->rec.op) {
+        case TRACE_OP_CACHE_PUT:
+            add_to_cache(replay_cache, op->key, replay_value, op->rec.size ? op->rec.size : 1);
+            break;
+        case TRACE_OP_CACHE_GET:
+            get_from_cache(replay_cache, op->key, out, sizeof(out));
+            break;
+        case TRACE_OP_LIST_ADD:
+            pthread_mutex_lock(&list_lock);
+            add_node(replay_list, op->rec.id, op->key);
+            pthread_mutex_unlock(&list_lock);
+            break;
+        case TRACE_OP_LIST_REMOVE:
+            pthread_mutex_lock(&list_lock);
+            remove_node_by_id(replay_list, op->rec.id);
+            pthread_mutex_unlock(&list_lock);
+            break;
+        case TRACE_OP_FILE_PROCESS:
+            process_file_with_leak(op->key);
+            break;
+    }
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    const Trace *trace = w->trace;
+
+    pthread_barrier_wait(&start_barrier);
+    for (size_t i = 0; i < trace->count; i++) {
+        const Op *op = &trace->ops[i];
+        if ((int)(op->rec.thread % (uint32_t)w->threads) != w->index) continue;
+        if (op->rec.op == 0 || op->rec.op >= TRACE_OP_COUNT) continue;
+
+        if (w->speed > 0)
+            wait_until(w->start_ns + (uint64_t)(op->rec.ts_ns / w->speed));
+        uint64_t begin = now_ns();
+        execute(op);
+        w->latencies[op->rec.op][w->counts[op->rec.op]++] = now_ns() - begin;
+    }
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t *sorted, size_t n, double p) {
+    return sorted[(size_t)(p * (double)(n - 1) + 0.5)];
+}
+
+static int replay(const Trace *trace, int threads, double speed, int cache_size, int reclaim,
+                  int free_evicted) {
+    replay_cache = create_cache(cache_size);
+    if (replay_cache) replay_cache->free_evicted = free_evicted;
+    if (replay_cache && reclaim >= 0 && cache_start_reclaimer(replay_cache, reclaim) != 0) {
+        fprintf(stderr, "Не удалось запустить фоновый поток освобождения\n");
+        return 2;
+    }
+    replay_list = create_list();
+    replay_value = calloc(1, trace->max_size ? trace->max_size : 1);
+    Worker *workers = calloc((size_t)threads, sizeof(Worker));
+    pthread_t *tids = calloc((size_t)threads, sizeof(pthread_t));
+    if (!replay_cache || !replay_list || !replay_value || !workers || !tids) {
+        fprintf(stderr, "Недостаточно памяти\n");
+        return 2;
+    }
+
+    /* место под задержки выделяется заранее, чтобы не мерить свой malloc,
+     * каждому потоку – ровно под его долю трассы */
+    for (int t = 0; t < threads; t++)
+        workers[t] = (Worker){ .trace = trace, .index = t, .threads = threads, .speed = speed };
+    size_t per_op[TRACE_OP_COUNT] = {0};
+    for (size_t i = 0; i < trace->count; i++) {
+        const TraceRecord *r = &trace->ops[i].rec;
+        if (r->op == 0 || r->op >= TRACE_OP_COUNT) continue;
+        workers[r->thread % (uint32_t)threads].capacity[r->op]++;
+        per_op[r->op]++;
+    }
+    for (int t = 0; t < threads; t++) {
+        for (int op = 1; op < TRACE_OP_COUNT; op++) {
+            workers[t].latencies[op] = malloc((workers[t].capacity[op] + 1) * sizeof(uint64_t));
+            if (!workers[t].latencies[op]) {
+                fprintf(stderr, "Недостаточно памяти\n");
+                return 2;
+            }
+        }
+    }
+
+    /* пик RSS после загрузки трассы и подготовки – точка отсчёта */
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long baseline_rss_kb = usage.ru_maxrss;
+
+    pthread_barrier_init(&start_barrier, NULL, (unsigned)threads + 1);
+    uint64_t start = now_ns() + 1000000;   /* 1 мс на запуск потоков */
+    for (int t = 0; t < threads; t++) {
+        workers[t].start_ns = start;
+        pthread_create(&tids[t], NULL, worker_main, &workers[t]);
+    }
+    pthread_barrier_wait(&start_barrier);
+    uint64_t released = now_ns();
+    for (int t = 0; t < threads; t++)
+        pthread_join(tids[t], NULL);
+    uint64_t elapsed = now_ns() - (speed > 0 && start > released ? start : released);
+    cache_stop_reclaimer(replay_cache);
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("{\"ops\": %zu, \"threads\": %d, \"speed\": %g, \"reclaim\": %d, \"free_evicted\": %d, \"elapsed_ms\": %.3f, "
+           "\"throughput_ops_s\": %.0f, \"baseline_rss_kb\": %ld, \"max_rss_kb\": %ld, "
+           "\"rss_growth_kb\": %ld, \"ops_by_type\": [\n",
+           trace->count, threads, speed, reclaim, free_evicted, elapsed / 1e6,
+           elapsed ? trace->count / (elapsed / 1e9) : 0.0, baseline_rss_kb, usage.ru_maxrss,
+           usage.ru_maxrss - baseline_rss_kb);
+
+    int first = 1;
+    for (int op = 1; op < TRACE_OP_COUNT; op++) {
+        size_t n = 0;
+        uint64_t *all = malloc((per_op[op] + 1) * sizeof(uint64_t));
+        for (int t = 0; t < threads; t++) {
+            memcpy(all + n, workers[t].latencies[op], workers[t].counts[op] * sizeof(uint64_t));
+            n += workers[t].counts[op];
+            free(workers[t].latencies[op]);
+        }
+        if (n) {
+            qsort(all, n, sizeof(uint64_t), cmp_u64);
+            printf("%s  {\"op\": \"%s\", \"count\": %zu, \"p50_ns\": %llu, \"p90_ns\": %llu, "
+                   "\"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}",
+                   first ? "" : ",\n", op_names[op], n,
+                   (unsigned long long)percentile(all, n, 0.50),
+                   (unsigned long long)percentile(all, n, 0.90),
+                   (unsigned long long)percentile(all, n, 0.99),
+                   (unsigned long long)percentile(all, n, 0.999),
+                   (unsigned long long)all[n - 1]);
+            first = 0;
+        }
+        free(all);
+    }
+    printf("\n]}\n");
+
+    pthread_barrier_destroy(&start_barrier);
+    free(workers);
+    free(tids);
+    return 0;
+}
+
+static void dump_trace(const Trace *trace) {
+    for (size_t i = 0; i < trace->count; i++) {
+        const TraceRecord *r = &trace->ops[i].rec;
+        printf("%12.6f  t%-3u %-12s id=%-6d size=%-6u %s\n", r->ts_ns / 1e9, r->thread,
+               r->op < TRACE_OP_COUNT ? op_names[r->op] : "?", r->id, r->size, trace->ops[i].key);
+    }
+}
+
+static void show_usage(const char *prog) {
+    printf("Usage: %s [--speed <x>] [--threads <n>] [--cache-size <n>] [--reclaim <n>]\n"
+           "       %*s [--free-evicted] <trace>\n"
+           "       %s --dump <trace>\n", prog, (int)strlen(prog), "", prog);
+}
+
+int main(int argc, char *argv[]) {
+    double speed = 1.0;
+    int threads = 0, cache_size = CACHE_SIZE, dump = 0, reclaim = -1, free_evicted = 0;
+    const char *path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--speed") == 0) speed = atof(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) threads = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--cache-size") == 0) cache_size = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--reclaim") == 0) reclaim = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--free-evicted") == 0) free_evicted = 1;
+        else if (strcmp(argv[i], "--dump") == 0) dump = 1;
+        else if (!path && argv[i][0] != '-') path = argv[i];
+        else {
+            show_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!path || speed < 0 || threads < 0 || cache_size < 1 || reclaim >= cache_size) {
+        show_usage(argv[0]);
+        return 2;
+    }
+
+    Trace trace;
+    if (load_trace(path, &trace) != 0) return 2;
+    if (dump) {
+        dump_trace(&trace);
+        return 0;
+    }
+    if (!threads) threads = trace.threads ? (int)trace.threads : 1;
+    return replay(&trace, threads, speed, cache_size, reclaim, free_evicted);
+}
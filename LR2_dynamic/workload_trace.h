@@ -0,0 +1,127 @@
+/*  workload_trace.h
+ *  ─────────────────────────────────────────────────────────────────────
+ *  Запись трассы операций над кэшем, списком и файлами.
+ *
+ *  * Запись включается переменной окружения WORKLOAD_TRACE=<file>;
+ *    без неё каждая точка записи стоит одной проверки глобального флага.
+ *  * Формат файла: заголовок TraceHeader, затем подряд записи
+ *    TraceRecord, за каждой – key_len байт строки-аргумента (ключ кэша,
+ *    данные узла или путь к файлу) без завершающего нуля.  Порядок
+ *    байтов – родной для машины.
+ *  * Файл заголовочный: программы по-прежнему собираются одной
+ *    командой gcc, а workload_replay.c читает тот же формат.
+ *  ----------------------------------------------------------------------- */
+
+#ifndef WORKLOAD_TRACE_H
+#define WORKLOAD_TRACE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_MAGIC   "WLTRACE1"
+#define TRACE_MAX_KEY 4096
+
+enum {
+    TRACE_OP_CACHE_PUT = 1,    /* add_to_cache(key, size) */
+    TRACE_OP_CACHE_GET,        /* get_from_cache(key) */
+    TRACE_OP_LIST_ADD,         /* add_node(id, data) */
+    TRACE_OP_LIST_REMOVE,      /* remove_node_by_id(id) */
+    TRACE_OP_FILE_PROCESS,     /* process_file_with_leak(path) */
+    TRACE_OP_COUNT
+};
+
+typedef struct {
+    char magic[8];
+    uint64_t start_realtime_ns;    /* время начала записи, для справки */
+} TraceHeader;
+
+typedef struct {
+    uint64_t ts_ns;                /* от начала записи */
+    uint32_t thread;               /* порядковый номер потока в записи */
+    uint8_t op;
+    uint8_t reserved;
+    uint16_t key_len;
+    int32_t id;
+    uint32_t size;
+} TraceRecord;
+
+/* ---------------------------------------------------------------------- */
+/*  Запись                                                                 */
+/* ---------------------------------------------------------------------- */
+
+enum { TRACE_UNKNOWN, TRACE_OFF, TRACE_ON };
+
+static int trace_state = TRACE_UNKNOWN;
+static FILE *trace_file;
+static uint64_t trace_start_ns;
+static uint32_t trace_threads;
+static __thread uint32_t trace_thread_id;   /* 0 – ещё не назначен */
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t trace_now_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void trace_close(void) {
+    pthread_mutex_lock(&trace_lock);
+    if (trace_file) fclose(trace_file);
+    trace_file = NULL;
+    __atomic_store_n(&trace_state, TRACE_OFF, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&trace_lock);
+}
+
+/* Вызывается под trace_lock при первой операции */
+static void trace_open_from_env(void) {
+    const char *path = getenv("WORKLOAD_TRACE");
+    __atomic_store_n(&trace_state, TRACE_OFF, __ATOMIC_RELAXED);
+    if (!path || !*path) return;
+
+    trace_file = fopen(path, "wb");
+    if (!trace_file) {
+        perror(path);
+        return;
+    }
+    TraceHeader hdr;
+    memcpy(hdr.magic, TRACE_MAGIC, 8);
+    hdr.start_realtime_ns = trace_now_ns(CLOCK_REALTIME);
+    fwrite(&hdr, sizeof(hdr), 1, trace_file);
+    trace_start_ns = trace_now_ns(CLOCK_MONOTONIC);
+    __atomic_store_n(&trace_state, TRACE_ON, __ATOMIC_RELAXED);
+    atexit(trace_close);
+}
+
+static void trace_record_slow(int op, int id, size_t size, const char *key) {
+    uint64_t now = trace_now_ns(CLOCK_MONOTONIC);
+    size_t key_len = key ? strlen(key) : 0;
+    if (key_len > TRACE_MAX_KEY) key_len = TRACE_MAX_KEY;
+
+    pthread_mutex_lock(&trace_lock);
+    if (trace_state == TRACE_UNKNOWN) trace_open_from_env();
+    if (trace_state == TRACE_ON) {
+        if (!trace_thread_id) trace_thread_id = ++trace_threads;
+        TraceRecord rec = {
+            .ts_ns = now > trace_start_ns ? now - trace_start_ns : 0,
+            .thread = trace_thread_id - 1,
+            .op = (uint8_t)op,
+            .key_len = (uint16_t)key_len,
+            .id = id,
+            .size = (uint32_t)size,
+        };
+        fwrite(&rec, sizeof(rec), 1, trace_file);
+        if (key_len) fwrite(key, 1, key_len, trace_file);
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+static inline void trace_record(int op, int id, size_t size, const char *key) {
+    if (__atomic_load_n(&trace_state, __ATOMIC_RELAXED) == TRACE_OFF) return;
+    trace_record_slow(op, id, size, key);
+}
+
+#endif /* WORKLOAD_TRACE_H */